@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Interpreter.hh"
+#include "RomFile.hh"
+
+// Instructions executed between timer ticks, matches default 600hz clock at 60fps
+constexpr uint64_t BENCH_INSTRUCTIONS_PER_FRAME = 10;
+
+struct BenchmarkSettings
+{
+    uint64_t instructions = 10'000'000;
+    int repetitions = 5;
+    std::string filter;
+    std::string trace_path;
+    std::vector<std::string> rom_paths;
+};
+
+struct BenchmarkCase
+{
+    std::string name;
+    std::vector<uint8_t> rom;
+    bool tick_timers = false;
+};
+
+static std::vector<uint8_t> AssembleROM(const std::vector<uint16_t>& opcodes)
+{
+    std::vector<uint8_t> rom;
+    rom.reserve(opcodes.size() * 2);
+
+    for (auto opcode: opcodes)
+    {
+        rom.push_back(opcode >> 8);
+        rom.push_back(opcode & 0xFF);
+    }
+
+    return rom;
+}
+
+// Chain of nested 2nnn calls, each level returns straight away once the deeper one returned
+static std::vector<uint8_t> AssembleCallChainROM(int depth)
+{
+    std::vector<uint16_t> opcodes{0x2204, 0x1200};
+
+    for (auto level = 0; level < depth; level++)
+    {
+        uint16_t next_level_address = 0x200 + (opcodes.size() + 2) * 2;
+
+        opcodes.push_back(0x2000 | next_level_address);
+        opcodes.push_back(0x00EE);
+    }
+
+    opcodes.push_back(0x00EE);
+
+    return AssembleROM(opcodes);
+}
+
+static std::vector<BenchmarkCase> CreateMicroBenchmarks()
+{
+    return {
+            {
+                    "micro/alu",
+                    AssembleROM({
+                                        0x6001, // V0 = 1
+                                        0x6103, // V1 = 3
+                                        0x8014, // V0 += V1
+                                        0x8125, // V1 -= V2
+                                        0x8203, // V2 ^= V0
+                                        0x8016, // V0 >>= 1
+                                        0x811E, // V1 <<= 1
+                                        0x7105, // V1 += 5
+                                        0x3000, // skip if V0 == 0
+                                        0x1204, // jump to loop
+                                        0x1200, // restart
+                                })
+            },
+            {
+                    "micro/draw",
+                    AssembleROM({
+                                        0xA050, // I = font glyph 0
+                                        0xD015, // draw 8x5 at V0, V1
+                                        0x7007, // V0 += 7
+                                        0x7103, // V1 += 3
+                                        0x1202, // jump to draw
+                                })
+            },
+            {
+                    "micro/bcd_memory",
+                    AssembleROM({
+                                        0xA300, // I = 0x300
+                                        0xF033, // BCD of V0
+                                        0xF355, // store V0-V3
+                                        0xF365, // load V0-V3
+                                        0x7001, // V0 += 1
+                                        0x1202, // jump to BCD
+                                })
+            },
+            {
+                    "micro/call_return",
+                    AssembleCallChainROM(12)
+            },
+    };
+}
+
+static std::vector<BenchmarkCase> CreateMacroBenchmarks(const std::vector<std::string>& rom_paths)
+{
+    std::vector<BenchmarkCase> cases;
+
+    for (auto& path: rom_paths)
+    {
+        cases.push_back({"macro/" + path.substr(path.find_last_of("/\\") + 1), ReadBinaryToVector(path), true});
+    }
+
+    return cases;
+}
+
+static double RunBenchmarkOnce(const BenchmarkCase& benchmark_case, uint64_t instructions,
+                               const std::string& trace_path)
+{
+    auto interpreter = std::make_unique<Chip8Interpreter>();
+    interpreter->LoadROM(benchmark_case.rom);
+
+    if (!trace_path.empty())
+    {
+        interpreter->StartTrace(trace_path);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < instructions; i++)
+    {
+        interpreter->ExecuteNextInstruction();
+
+        if (benchmark_case.tick_timers && (i + 1) % BENCH_INSTRUCTIONS_PER_FRAME == 0)
+        {
+            interpreter->TickSoundTimer();
+            interpreter->TickDelayTimer();
+            interpreter->DrawFlag(false);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// One JSON object per line, keys always in the same order so outputs of two commits can be diffed directly
+static void ReportResult(const std::string& name, const BenchmarkSettings& settings,
+                         std::vector<double> elapsed_ns)
+{
+    std::sort(elapsed_ns.begin(), elapsed_ns.end());
+
+    double median_ns_per_instruction = elapsed_ns[elapsed_ns.size() / 2] / settings.instructions;
+    double best_ns_per_instruction = elapsed_ns.front() / settings.instructions;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"benchmark\":\"" << name << "\""
+              << ",\"instructions\":" << settings.instructions
+              << ",\"repetitions\":" << settings.repetitions
+              << ",\"ns_per_instruction\":" << median_ns_per_instruction
+              << ",\"best_ns_per_instruction\":" << best_ns_per_instruction
+              << ",\"mips\":" << 1000.0 / median_ns_per_instruction
+              << "}" << std::endl;
+}
+
+static void ReportError(const std::string& name, const std::string& message)
+{
+    std::cout << "{\"benchmark\":\"" << name << "\",\"error\":\"" << message << "\"}" << std::endl;
+}
+
+static BenchmarkSettings ParseBenchmarkArguments(const std::vector<std::string>& args)
+{
+    BenchmarkSettings settings{};
+
+    for (auto& arg: args)
+    {
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-instructions:", 0) == 0)
+            {
+                settings.instructions = std::stoull(value);
+            }
+            else if (arg.rfind("-repetitions:", 0) == 0)
+            {
+                settings.repetitions = std::stoi(value);
+            }
+            else if (arg.rfind("-filter:", 0) == 0)
+            {
+                settings.filter = value;
+            }
+            else if (arg.rfind("-trace:", 0) == 0)
+            {
+                settings.trace_path = value;
+            }
+            else if (arg[0] == '-')
+            {
+                throw std::invalid_argument("Invalid command line argument: " + arg);
+            }
+            else
+            {
+                settings.rom_paths.push_back(arg);
+            }
+        }
+        catch (const std::invalid_argument& e)
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    if (settings.instructions == 0 || settings.repetitions <= 0)
+    {
+        throw std::invalid_argument("Instruction and repetition counts need to be positive");
+    }
+
+    return settings;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-bench [rom-paths] [-instructions:x] [-repetitions:x] [-filter:x] [-trace:x]" << std::endl;
+
+        return -1;
+    }
+
+    BenchmarkSettings settings{};
+    std::vector<BenchmarkCase> cases;
+
+    try
+    {
+        settings = ParseBenchmarkArguments(std::vector<std::string>(argv + 1, argv + argc));
+
+        cases = CreateMicroBenchmarks();
+
+        auto macro_cases = CreateMacroBenchmarks(settings.rom_paths);
+        cases.insert(cases.end(), macro_cases.begin(), macro_cases.end());
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return -2;
+    }
+
+    for (auto& benchmark_case: cases)
+    {
+        if (benchmark_case.name.find(settings.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        try
+        {
+            // Warm-up run so first repetition doesn't pay for cold caches
+            RunBenchmarkOnce(benchmark_case, std::min<uint64_t>(settings.instructions, 100'000), settings.trace_path);
+
+            std::vector<double> elapsed_ns;
+            for (auto i = 0; i < settings.repetitions; i++)
+            {
+                elapsed_ns.push_back(RunBenchmarkOnce(benchmark_case, settings.instructions, settings.trace_path));
+            }
+
+            ReportResult(benchmark_case.name, settings, elapsed_ns);
+        }
+        catch (const std::exception& e)
+        {
+            ReportError(benchmark_case.name, e.what());
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+#include "Interpreter.hh"
+
+// Input layout: variant byte (modulo the variant count), 2 byte big endian ROM length, ROM, then one byte per
+// frame of key input. Frame bytes with bit 4 set hold the key in the low nibble, anything else releases every key.
+constexpr size_t FUZZ_HEADER_SIZE = 3;
+constexpr size_t FUZZ_VARIANT_COUNT = 3;
+constexpr uint32_t FUZZ_MAX_FRAMES = 256;
+constexpr uint32_t FUZZ_INSTRUCTIONS_PER_FRAME = 10;
+
+// Only ROMs running out of input are interesting, everything else gets this many frames with no key held
+constexpr uint32_t FUZZ_MIN_FRAMES = 16;
+
+constexpr size_t FUZZ_EDGE_COUNTER_COUNT = 1 << 16;
+
+// libFuzzer picks up every counter in this section as extra coverage, so PC->PC edges of the emulated
+// program guide it besides the edges of the interpreter itself
+__attribute__((used, section("__libfuzzer_extra_counters")))
+static uint8_t edge_counters[FUZZ_EDGE_COUNTER_COUNT];
+
+static void ApplyFrameInput(Chip8Interpreter& interpreter, uint8_t frame_input)
+{
+    for (auto key = 0; key < 16; key++)
+    {
+        bool pressed = (frame_input & 0x10) != 0 && (frame_input & 0x0F) == key;
+        interpreter.HandleKeyEvent(pressed ? CalicoEvent::KeyDown : CalicoEvent::KeyUp, static_cast<CalicoKey>(key));
+    }
+}
+
+// Machine of one variant with the snapshot every run starts from
+struct FuzzMachine
+{
+    explicit FuzzMachine(Chip8Variant variant)
+            : interpreter(variant)
+    {
+        interpreter.SeedRandom(1);
+
+        pristine_state = interpreter.SaveState();
+        pristine_extended_memory = interpreter.SaveExtendedMemory();
+        memory_size = variant == Chip8Variant::XOChip ? C8_XO_MEMORY_SIZE : C8_MEMORY_SIZE;
+    }
+
+    void Reset()
+    {
+        interpreter.LoadState(pristine_state);
+
+        // XO-CHIP memory above 4 KB isn't part of the state, ROMs and Fx55 can write there
+        if (!pristine_extended_memory.empty())
+        {
+            interpreter.LoadExtendedMemory(pristine_extended_memory);
+        }
+    }
+
+    Chip8Interpreter interpreter;
+    Chip8MachineState pristine_state;
+    std::vector<uint8_t> pristine_extended_memory;
+    size_t memory_size;
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    // Constructed once, every run restores a snapshot instead of rebuilding the machine and its fontset
+    static std::array<FuzzMachine, FUZZ_VARIANT_COUNT> machines{FuzzMachine(Chip8Variant::Chip8),
+                                                                FuzzMachine(Chip8Variant::SuperChip),
+                                                                FuzzMachine(Chip8Variant::XOChip)};
+
+    if (size < FUZZ_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    auto& machine = machines[data[0] % FUZZ_VARIANT_COUNT];
+    auto& interpreter = machine.interpreter;
+
+    size_t rom_size = std::min<size_t>((data[1] << 8) | data[2], size - FUZZ_HEADER_SIZE);
+    const uint8_t* frame_inputs = data + FUZZ_HEADER_SIZE + rom_size;
+    size_t frame_count = std::min<size_t>(size - FUZZ_HEADER_SIZE - rom_size, FUZZ_MAX_FRAMES);
+
+    if (rom_size == 0 || rom_size > machine.memory_size - 0x200)
+    {
+        return 0;
+    }
+
+    machine.Reset();
+    interpreter.LoadROM(data + FUZZ_HEADER_SIZE, rom_size);
+
+    uint16_t previous_pc = interpreter.GetProgramCounter();
+
+    // Pristine state has every key released
+    uint8_t held_input = 0;
+
+    // Errors the interpreter reports by itself (invalid opcode, stack underflow) end the run normally,
+    // crashes are left to sanitizers and library assertions
+    try
+    {
+        for (size_t frame = 0; frame < std::max<size_t>(frame_count, FUZZ_MIN_FRAMES); frame++)
+        {
+            uint8_t frame_input = frame < frame_count && (frame_inputs[frame] & 0x10) != 0 ? frame_inputs[frame] & 0x1F : 0;
+
+            if (frame_input != held_input)
+            {
+                ApplyFrameInput(interpreter, frame_input);
+                held_input = frame_input;
+            }
+
+            for (uint32_t instruction = 0; instruction < FUZZ_INSTRUCTIONS_PER_FRAME; instruction++)
+            {
+                uint16_t pc = interpreter.GetProgramCounter();
+                edge_counters[((previous_pc << 4) ^ pc) & (FUZZ_EDGE_COUNTER_COUNT - 1)]++;
+                previous_pc = pc;
+
+                interpreter.ExecuteNextInstruction();
+            }
+
+            interpreter.TickSoundTimer();
+            interpreter.TickDelayTimer();
+        }
+    }
+    catch (const std::exception& e)
+    {
+    }
+
+    return 0;
+}
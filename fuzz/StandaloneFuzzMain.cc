@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "RomFile.hh"
+
+// Driver for compilers without libFuzzer: replays corpus files or measures throughput on random inputs
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static void RunFile(const std::string& path)
+{
+    auto data = ReadBinaryToVector(path);
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+
+    std::cout << "ran " << path << " (" << data.size() << " bytes)" << std::endl;
+}
+
+static void RunRandomInputs(uint64_t runs, size_t max_length)
+{
+    uint32_t random_state = 0x2545F491;
+    auto next_random = [&random_state]
+    {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+
+        return random_state;
+    };
+
+    std::vector<uint8_t> data(max_length);
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t run = 0; run < runs; run++)
+    {
+        size_t length = 3 + next_random() % (max_length - 2);
+
+        for (auto& byte: data)
+        {
+            byte = next_random();
+        }
+
+        // Keep the ROM length within the input, otherwise most runs are just the frame inputs.
+        // First byte stays random and picks the variant.
+        data[1] = 0;
+        data[2] = next_random() % (length - 2);
+
+        LLVMFuzzerTestOneInput(data.data(), length);
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << runs << " runs in " << seconds << " s (" << static_cast<uint64_t>(runs / seconds)
+              << " exec/s)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t runs = 0;
+    size_t max_length = 256;
+    std::vector<std::string> paths;
+
+    for (auto i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-runs:", 0) == 0)
+            {
+                runs = std::stoull(value);
+            }
+            else if (arg.rfind("-max_len:", 0) == 0)
+            {
+                max_length = std::max<size_t>(3, std::stoul(value));
+            }
+            else if (arg[0] == '-')
+            {
+                throw std::invalid_argument(arg);
+            }
+            else
+            {
+                paths.push_back(arg);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Invalid command line argument: " << arg << std::endl;
+
+            return -2;
+        }
+    }
+
+    for (auto& path: paths)
+    {
+        if (!std::filesystem::is_directory(path))
+        {
+            RunFile(path);
+            continue;
+        }
+
+        for (auto& entry: std::filesystem::recursive_directory_iterator(path))
+        {
+            if (entry.is_regular_file())
+            {
+                RunFile(entry.path().string());
+            }
+        }
+    }
+
+    if (runs > 0)
+    {
+        RunRandomInputs(runs, max_length);
+    }
+
+    return 0;
+}
@@ -0,0 +1,519 @@
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <sstream>
+#include "Analyzer.hh"
+
+// Sanity limit for jump tables made of 1nnn entries, V0 can't index further than 0xFF bytes anyway
+constexpr int ANALYZER_MAX_JUMP_TABLE_ENTRIES = 128;
+
+enum class InstructionFlow
+{
+    Continue,
+    Jump,
+    Skip,
+    Call,
+    JumpTable,
+    Return,
+    Invalid
+};
+
+// Mirrors which opcodes Chip8Interpreter::ExecuteNextInstruction accepts and how they move PC
+static InstructionFlow GetInstructionFlow(uint16_t opcode)
+{
+    switch (opcode & 0xF000)
+    {
+        case 0x0000:
+            if (opcode == 0x00EE)
+            {
+                return InstructionFlow::Return;
+            }
+
+            // Every other 0nnn besides 00E0 is executed as a call
+            return opcode == 0x00E0 ? InstructionFlow::Continue : InstructionFlow::Call;
+
+        case 0x1000:
+            return InstructionFlow::Jump;
+
+        case 0x2000:
+            return InstructionFlow::Call;
+
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+            return InstructionFlow::Skip;
+
+        case 0x8000:
+            switch (DecodeNFromOpcode(opcode))
+            {
+                case 0x0:
+                case 0x1:
+                case 0x2:
+                case 0x3:
+                case 0x4:
+                case 0x5:
+                case 0x6:
+                case 0x7:
+                case 0xE:
+                    return InstructionFlow::Continue;
+
+                default:
+                    return InstructionFlow::Invalid;
+            }
+
+        case 0xB000:
+            return InstructionFlow::JumpTable;
+
+        case 0xE000:
+            return DecodeNNFromOpcode(opcode) == 0x9E || DecodeNNFromOpcode(opcode) == 0xA1
+                   ? InstructionFlow::Skip : InstructionFlow::Invalid;
+
+        case 0xF000:
+            switch (DecodeNNFromOpcode(opcode))
+            {
+                case 0x07:
+                case 0x0A:
+                case 0x15:
+                case 0x18:
+                case 0x1E:
+                case 0x29:
+                case 0x33:
+                case 0x55:
+                case 0x65:
+                    return InstructionFlow::Continue;
+
+                default:
+                    return InstructionFlow::Invalid;
+            }
+
+        default:
+            return InstructionFlow::Continue;
+    }
+}
+
+static bool IsValidInstructionAddress(int address)
+{
+    return address >= 0 && address + 1 < C8_MEMORY_SIZE;
+}
+
+static uint16_t FetchOpcode(const std::array<uint8_t, C8_MEMORY_SIZE>& memory, uint16_t address)
+{
+    return (memory[address] << 8) | memory[address + 1];
+}
+
+// Targets of Bnnn, either single one when V0 was just set by 6xnn or entries of a 1nnn table at nnn
+static std::vector<uint16_t> ResolveJumpTable(const std::array<uint8_t, C8_MEMORY_SIZE>& memory,
+                                              uint16_t opcode, int previous_opcode)
+{
+    uint16_t base = DecodeNNNFromOpcode(opcode);
+
+    if (previous_opcode >= 0 && (previous_opcode & 0xFF00) == 0x6000)
+    {
+        return {static_cast<uint16_t>(base + DecodeNNFromOpcode(previous_opcode))};
+    }
+
+    std::vector<uint16_t> targets;
+
+    for (auto entry = 0; entry < ANALYZER_MAX_JUMP_TABLE_ENTRIES; entry++)
+    {
+        int address = base + entry * 2;
+
+        if (!IsValidInstructionAddress(address) || (FetchOpcode(memory, address) & 0xF000) != 0x1000)
+        {
+            break;
+        }
+
+        targets.push_back(address);
+    }
+
+    return targets;
+}
+
+Chip8ControlFlowGraph AnalyzeROM(const std::vector<uint8_t>& binary)
+{
+    Chip8ControlFlowGraph graph{};
+
+    // Same memory layout the interpreter starts with
+    std::array<uint8_t, C8_MEMORY_SIZE> memory{0};
+    std::copy(C8_FONTSET.begin(), C8_FONTSET.end(), memory.begin() + 0x050);
+    std::copy_n(binary.begin(), std::min<size_t>(binary.size(), C8_MEMORY_SIZE - 0x200), memory.begin() + 0x200);
+
+    std::bitset<C8_MEMORY_SIZE> instruction_starts;
+    std::bitset<C8_MEMORY_SIZE> leaders;
+    std::bitset<C8_MEMORY_SIZE> call_targets;
+
+    // Every address gets pushed at most once, guarded by leaders bitmap
+    std::array<uint16_t, C8_MEMORY_SIZE> worklist{};
+    size_t worklist_size = 0;
+
+    auto add_leader = [&](int address)
+    {
+        if (IsValidInstructionAddress(address) && !leaders.test(address))
+        {
+            leaders.set(address);
+            worklist[worklist_size++] = address;
+        }
+    };
+
+    add_leader(0x200);
+
+    // First pass discovers reachable instructions and where blocks start
+    while (worklist_size > 0)
+    {
+        uint16_t address = worklist[--worklist_size];
+        int previous_opcode = -1;
+
+        while (IsValidInstructionAddress(address))
+        {
+            // Fell through into already discovered code, it becomes start of a block of its own
+            if (instruction_starts.test(address))
+            {
+                leaders.set(address);
+                break;
+            }
+
+            instruction_starts.set(address);
+
+            uint16_t opcode = FetchOpcode(memory, address);
+            InstructionFlow flow = GetInstructionFlow(opcode);
+
+            if (flow == InstructionFlow::Continue)
+            {
+                previous_opcode = opcode;
+                address += 2;
+                continue;
+            }
+
+            switch (flow)
+            {
+                case InstructionFlow::Jump:
+                    add_leader(DecodeNNNFromOpcode(opcode));
+                    break;
+
+                case InstructionFlow::Call:
+                    if (IsValidInstructionAddress(DecodeNNNFromOpcode(opcode)))
+                    {
+                        call_targets.set(DecodeNNNFromOpcode(opcode));
+                    }
+
+                    add_leader(DecodeNNNFromOpcode(opcode));
+                    add_leader(address + 2);
+                    break;
+
+                case InstructionFlow::Skip:
+                    add_leader(address + 2);
+                    add_leader(address + 4);
+                    break;
+
+                case InstructionFlow::JumpTable:
+                {
+                    Chip8JumpTable jump_table{address, DecodeNNNFromOpcode(opcode),
+                                              ResolveJumpTable(memory, opcode, previous_opcode)};
+
+                    for (auto target: jump_table.targets)
+                    {
+                        add_leader(target);
+                    }
+
+                    graph.jump_tables.push_back(std::move(jump_table));
+                }
+                    break;
+
+                default:
+                    break;
+            }
+
+            break;
+        }
+    }
+
+    // Second pass splits discovered code into blocks and tracks I within each block
+    std::vector<Chip8SelfModifyingWrite> writes;
+
+    for (auto start = 0; start < C8_MEMORY_SIZE; start++)
+    {
+        if (!leaders.test(start) || !instruction_starts.test(start))
+        {
+            continue;
+        }
+
+        Chip8BasicBlock block{static_cast<uint16_t>(start), static_cast<uint16_t>(start)};
+        int known_i = -1;
+        uint16_t pc = start;
+
+        auto add_edge = [&](int to, Chip8EdgeKind kind)
+        {
+            if (IsValidInstructionAddress(to))
+            {
+                graph.edges.push_back({block.start, static_cast<uint16_t>(to), kind});
+            }
+        };
+
+        while (true)
+        {
+            uint16_t opcode = FetchOpcode(memory, pc);
+            uint16_t next = pc + 2;
+
+            graph.code_bytes.set(pc);
+            graph.code_bytes.set(pc + 1);
+
+            if ((opcode & 0xF000) == 0xA000)
+            {
+                known_i = DecodeNNNFromOpcode(opcode);
+            }
+            else if ((opcode & 0xF0FF) == 0xF01E || (opcode & 0xF0FF) == 0xF029)
+            {
+                known_i = -1;
+            }
+            else if ((opcode & 0xF000) == 0xD000 && known_i >= 0 && DecodeNFromOpcode(opcode) != 0)
+            {
+                graph.data_regions.push_back({static_cast<uint16_t>(known_i), DecodeNFromOpcode(opcode)});
+            }
+            else if ((opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055)
+            {
+                uint8_t length = (opcode & 0x00FF) == 0x33 ? 3 : DecodeXFromOpcode(opcode) + 1;
+                writes.push_back({pc, known_i >= 0, static_cast<uint16_t>(std::max(known_i, 0)), length});
+            }
+
+            InstructionFlow flow = GetInstructionFlow(opcode);
+
+            if (flow == InstructionFlow::Continue)
+            {
+                if (IsValidInstructionAddress(next) && !leaders.test(next))
+                {
+                    pc = next;
+                    continue;
+                }
+
+                add_edge(next, Chip8EdgeKind::Fallthrough);
+            }
+            else if (flow == InstructionFlow::Jump)
+            {
+                add_edge(DecodeNNNFromOpcode(opcode), Chip8EdgeKind::Jump);
+            }
+            else if (flow == InstructionFlow::Call)
+            {
+                add_edge(DecodeNNNFromOpcode(opcode), Chip8EdgeKind::Call);
+                add_edge(next, Chip8EdgeKind::Fallthrough);
+            }
+            else if (flow == InstructionFlow::Skip)
+            {
+                add_edge(next, Chip8EdgeKind::Skip);
+                add_edge(next + 2, Chip8EdgeKind::Skip);
+            }
+            else if (flow == InstructionFlow::JumpTable)
+            {
+                auto jump_table = std::find_if(graph.jump_tables.begin(), graph.jump_tables.end(),
+                                               [pc](const Chip8JumpTable& table) { return table.pc == pc; });
+
+                for (auto target: jump_table->targets)
+                {
+                    add_edge(target, Chip8EdgeKind::JumpTable);
+                }
+            }
+
+            block.ends_with_return = flow == InstructionFlow::Return;
+            block.ends_with_invalid_opcode = flow == InstructionFlow::Invalid;
+            block.end = next;
+
+            break;
+        }
+
+        graph.blocks.push_back(block);
+    }
+
+    for (auto address = 0; address < C8_MEMORY_SIZE; address++)
+    {
+        if (call_targets.test(address))
+        {
+            graph.call_targets.push_back(address);
+        }
+    }
+
+    std::sort(graph.data_regions.begin(), graph.data_regions.end(),
+              [](const Chip8DataRegion& a, const Chip8DataRegion& b)
+              {
+                  return a.start != b.start ? a.start < b.start : a.length < b.length;
+              });
+    graph.data_regions.erase(std::unique(graph.data_regions.begin(), graph.data_regions.end(),
+                                         [](const Chip8DataRegion& a, const Chip8DataRegion& b)
+                                         {
+                                             return a.start == b.start && a.length == b.length;
+                                         }),
+                             graph.data_regions.end());
+
+    // Writes are only interesting when they might land on code, which is known only after the second pass
+    for (auto& write: writes)
+    {
+        bool overlaps_code = !write.address_known;
+
+        for (auto offset = 0; offset < write.length && !overlaps_code; offset++)
+        {
+            overlaps_code = graph.code_bytes.test((write.address + offset) % C8_MEMORY_SIZE);
+        }
+
+        if (overlaps_code)
+        {
+            graph.self_modifying_writes.push_back(write);
+        }
+    }
+
+    return graph;
+}
+
+static std::string FormatAddress(uint16_t address)
+{
+    std::stringstream stream;
+    stream << "0x" << std::uppercase << std::hex << std::setfill('0') << std::setw(3) << address;
+
+    return stream.str();
+}
+
+static const char* GetEdgeKindName(Chip8EdgeKind kind)
+{
+    switch (kind)
+    {
+        case Chip8EdgeKind::Fallthrough:
+            return "fallthrough";
+
+        case Chip8EdgeKind::Jump:
+            return "jump";
+
+        case Chip8EdgeKind::Skip:
+            return "skip";
+
+        case Chip8EdgeKind::Call:
+            return "call";
+
+        case Chip8EdgeKind::JumpTable:
+            return "jump_table";
+    }
+
+    return "";
+}
+
+std::string FormatControlFlowGraphAsDot(const Chip8ControlFlowGraph& graph)
+{
+    std::string dot = "digraph chip8 {\n    node [shape=box, fontname=\"monospace\"];\n";
+
+    for (auto& block: graph.blocks)
+    {
+        bool is_call_target = std::binary_search(graph.call_targets.begin(), graph.call_targets.end(), block.start);
+
+        dot += "    \"" + FormatAddress(block.start) + "\" [label=\"" + FormatAddress(block.start) + "-" +
+               FormatAddress(block.end - 2) + (block.ends_with_return ? "\\nreturn" : "") +
+               (block.ends_with_invalid_opcode ? "\\ninvalid opcode" : "") + "\"" +
+               (is_call_target ? ", style=bold" : "") + "];\n";
+    }
+
+    for (auto& edge: graph.edges)
+    {
+        dot += "    \"" + FormatAddress(edge.from) + "\" -> \"" + FormatAddress(edge.to) + "\"";
+
+        switch (edge.kind)
+        {
+            case Chip8EdgeKind::Call:
+                dot += " [style=dashed]";
+                break;
+
+            case Chip8EdgeKind::JumpTable:
+                dot += " [style=dotted]";
+                break;
+
+            case Chip8EdgeKind::Skip:
+                dot += " [color=blue]";
+                break;
+
+            default:
+                break;
+        }
+
+        dot += ";\n";
+    }
+
+    for (auto& region: graph.data_regions)
+    {
+        dot += "    \"data " + FormatAddress(region.start) + "\" [shape=note, label=\"sprite " +
+               FormatAddress(region.start) + " (" + std::to_string(region.length) + " bytes)\"];\n";
+    }
+
+    for (auto& write: graph.self_modifying_writes)
+    {
+        dot += "    \"" + FormatAddress(write.pc) + " write\" [shape=octagon, color=red, label=\"write at " +
+               FormatAddress(write.pc) + " to " + (write.address_known ? FormatAddress(write.address) : "unknown") +
+               "\"];\n";
+    }
+
+    return dot + "}\n";
+}
+
+std::string FormatControlFlowGraphAsJson(const Chip8ControlFlowGraph& graph)
+{
+    std::string json = "{\"entry\":512,\"blocks\":[";
+
+    for (size_t i = 0; i < graph.blocks.size(); i++)
+    {
+        auto& block = graph.blocks[i];
+
+        json += std::string(i == 0 ? "" : ",") + "{\"start\":" + std::to_string(block.start) +
+                ",\"end\":" + std::to_string(block.end) +
+                ",\"return\":" + (block.ends_with_return ? "true" : "false") +
+                ",\"invalid_opcode\":" + (block.ends_with_invalid_opcode ? "true" : "false") + "}";
+    }
+
+    json += "],\"edges\":[";
+
+    for (size_t i = 0; i < graph.edges.size(); i++)
+    {
+        auto& edge = graph.edges[i];
+
+        json += std::string(i == 0 ? "" : ",") + "{\"from\":" + std::to_string(edge.from) +
+                ",\"to\":" + std::to_string(edge.to) + ",\"kind\":\"" + GetEdgeKindName(edge.kind) + "\"}";
+    }
+
+    json += "],\"call_targets\":[";
+
+    for (size_t i = 0; i < graph.call_targets.size(); i++)
+    {
+        json += (i == 0 ? "" : ",") + std::to_string(graph.call_targets[i]);
+    }
+
+    json += "],\"jump_tables\":[";
+
+    for (size_t i = 0; i < graph.jump_tables.size(); i++)
+    {
+        auto& jump_table = graph.jump_tables[i];
+
+        json += std::string(i == 0 ? "" : ",") + "{\"pc\":" + std::to_string(jump_table.pc) +
+                ",\"base\":" + std::to_string(jump_table.base) + ",\"targets\":[";
+
+        for (size_t j = 0; j < jump_table.targets.size(); j++)
+        {
+            json += (j == 0 ? "" : ",") + std::to_string(jump_table.targets[j]);
+        }
+
+        json += "]}";
+    }
+
+    json += "],\"data_regions\":[";
+
+    for (size_t i = 0; i < graph.data_regions.size(); i++)
+    {
+        json += std::string(i == 0 ? "" : ",") + "{\"start\":" + std::to_string(graph.data_regions[i].start) +
+                ",\"length\":" + std::to_string(graph.data_regions[i].length) + "}";
+    }
+
+    json += "],\"self_modifying_writes\":[";
+
+    for (size_t i = 0; i < graph.self_modifying_writes.size(); i++)
+    {
+        auto& write = graph.self_modifying_writes[i];
+
+        json += std::string(i == 0 ? "" : ",") + "{\"pc\":" + std::to_string(write.pc) +
+                ",\"address\":" + (write.address_known ? std::to_string(write.address) : "null") +
+                ",\"length\":" + std::to_string(write.length) + "}";
+    }
+
+    return json + "]}\n";
+}
@@ -0,0 +1,80 @@
+#ifndef CALICOC8_ANALYZER_HH
+#define CALICOC8_ANALYZER_HH
+
+#include <cstdint>
+#include <bitset>
+#include <string>
+#include <vector>
+#include "Interpreter.hh"
+
+enum class Chip8EdgeKind
+{
+    Fallthrough,
+    Jump,
+    // Both outcomes of skip instructions (3xnn, 4xnn, 5xy0, 9xy0, Ex9E, ExA1)
+    Skip,
+    Call,
+    JumpTable
+};
+
+struct Chip8BasicBlock
+{
+    uint16_t start = 0;
+    // Address right after the last instruction
+    uint16_t end = 0;
+    bool ends_with_return = false;
+    bool ends_with_invalid_opcode = false;
+};
+
+struct Chip8ControlFlowEdge
+{
+    // Start address of source block, end address of target
+    uint16_t from = 0;
+    uint16_t to = 0;
+    Chip8EdgeKind kind = Chip8EdgeKind::Fallthrough;
+};
+
+// Bnnn, targets are only known when entries at nnn are 1nnn jumps or V0 is set right before
+struct Chip8JumpTable
+{
+    uint16_t pc = 0;
+    uint16_t base = 0;
+    std::vector<uint16_t> targets;
+};
+
+// Sprites referenced by Annn followed by Dxyn within the same block
+struct Chip8DataRegion
+{
+    uint16_t start = 0;
+    uint16_t length = 0;
+};
+
+// Fx33/Fx55 whose target is unknown or overlaps instructions
+struct Chip8SelfModifyingWrite
+{
+    uint16_t pc = 0;
+    bool address_known = false;
+    uint16_t address = 0;
+    uint8_t length = 0;
+};
+
+struct Chip8ControlFlowGraph
+{
+    std::vector<Chip8BasicBlock> blocks;
+    std::vector<Chip8ControlFlowEdge> edges;
+    std::vector<uint16_t> call_targets;
+    std::vector<Chip8JumpTable> jump_tables;
+    std::vector<Chip8DataRegion> data_regions;
+    std::vector<Chip8SelfModifyingWrite> self_modifying_writes;
+
+    // Every byte belonging to a reachable instruction
+    std::bitset<C8_MEMORY_SIZE> code_bytes;
+};
+
+// Recursive descent from 0x200 following the same opcode semantics as Chip8Interpreter
+Chip8ControlFlowGraph AnalyzeROM(const std::vector<uint8_t>& binary);
+
+std::string FormatControlFlowGraphAsDot(const Chip8ControlFlowGraph& graph);
+std::string FormatControlFlowGraphAsJson(const Chip8ControlFlowGraph& graph);
+
+#endif //CALICOC8_ANALYZER_HH
@@ -1,7 +1,9 @@
 #include <exception>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include "CommandLine.hh"
+#include "RomCatalog.hh"
 
 static std::vector<std::string> SplitStringByDelimeter(const std::string& str, char delimeter)
 {
@@ -20,9 +22,10 @@ static std::vector<std::string> SplitStringByDelimeter(const std::string& str, c
     return tokens;
 }
 
-ApplicationCmdSettings ParseSpecialArguments(const std::vector<std::string>& args)
+ApplicationCmdSettings ParseSpecialArguments(const std::vector<std::string>& args,
+                                             const ApplicationCmdSettings& defaults)
 {
-    ApplicationCmdSettings application_cmd_settings{};
+    ApplicationCmdSettings application_cmd_settings = defaults;
 
     for (auto& arg: args)
     {
@@ -72,6 +75,104 @@ ApplicationCmdSettings ParseSpecialArguments(const std::vector<std::string>& arg
                 throw std::invalid_argument("Unable to parse value of command line argument: " + arg);
             }
         }
+        else if (arg_tokens[0] == "-trace")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            application_cmd_settings.trace_path = arg_tokens[1];
+        }
+        else if (arg_tokens[0] == "-debug")
+        {
+            if (arg_tokens.size() > 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            application_cmd_settings.debugger_enabled = true;
+            application_cmd_settings.debugger_socket_path = arg_tokens.size() == 2 ? arg_tokens[1] : "";
+        }
+        else if (arg_tokens[0] == "-variant")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            application_cmd_settings.variant = ParseChip8Variant(arg_tokens[1]);
+        }
+        else if (arg_tokens[0] == "-keymap")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            ValidateKeymap(arg_tokens[1]);
+            application_cmd_settings.keymap = arg_tokens[1];
+        }
+        else if (arg_tokens[0] == "-catalog")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            application_cmd_settings.catalog_path = arg_tokens[1];
+        }
+        else if (arg_tokens[0] == "-shm")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            application_cmd_settings.shared_frames_name = arg_tokens[1];
+        }
+        else if (arg_tokens[0] == "-export" || arg_tokens[0] == "-export_audio")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            (arg_tokens[0] == "-export" ? application_cmd_settings.export_video_path
+                                        : application_cmd_settings.export_audio_path) = arg_tokens[1];
+        }
+        else if (arg_tokens[0] == "-export_scale" || arg_tokens[0] == "-frames")
+        {
+            if (arg_tokens.size() != 2)
+            {
+                throw std::invalid_argument("Invalid command line argument format: " + arg);
+            }
+
+            try
+            {
+                if (arg_tokens[0] == "-export_scale")
+                {
+                    application_cmd_settings.export_scale = std::stoi(arg_tokens[1]);
+                }
+                else
+                {
+                    application_cmd_settings.frame_limit = std::stoull(arg_tokens[1]);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                throw std::invalid_argument("Unable to parse value of command line argument: " + arg);
+            }
+        }
+        else if (arg_tokens[0] == "-headless")
+        {
+            if (arg_tokens.size() != 1)
+            {
+                throw std::invalid_argument("Invalid command line argument: " + arg);
+            }
+
+            application_cmd_settings.headless = true;
+        }
         else
         {
             throw std::invalid_argument("Invalid command line argument: " + arg);
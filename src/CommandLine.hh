@@ -1,14 +1,35 @@
 #ifndef CALICOC8_COMMANDLINE_HH
 #define CALICOC8_COMMANDLINE_HH
 
+#include <cstdint>
+#include <vector>
+#include <string>
+#include "Interpreter.hh"
+
 struct ApplicationCmdSettings
 {
     bool sound_enabled = true;
     int window_size_x = 640;
     int window_size_y = 320;
     uint32_t clock_speed = 600;
+    Chip8Variant variant = Chip8Variant::Chip8;
+    std::string keymap = C8_DEFAULT_KEYMAP;
+    // Directory indexed by calico-catalog, metadata of a known ROM replaces the defaults
+    std::string catalog_path;
+    std::string trace_path;
+    bool debugger_enabled = false;
+    std::string debugger_socket_path;
+    std::string export_video_path;
+    std::string export_audio_path;
+    int export_scale = 10;
+    bool headless = false;
+    std::string shared_frames_name;
+    // 0 runs until the window is closed
+    uint64_t frame_limit = 0;
 };
 
-ApplicationCmdSettings ParseSpecialArguments(const std::vector<std::string>& args);
+// Arguments are applied on top of defaults, ex. values from the ROM catalog
+ApplicationCmdSettings ParseSpecialArguments(const std::vector<std::string>& args,
+                                             const ApplicationCmdSettings& defaults = {});
 
 #endif //CALICOC8_COMMANDLINE_HH
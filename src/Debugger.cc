@@ -0,0 +1,606 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <iomanip>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Debugger.hh"
+
+constexpr int DEBUGGER_INDEX_REGISTER = 0x10;
+
+static const char* DEBUGGER_HELP =
+        "break <addr>              pause before executing instruction at addr\n"
+        "delete <addr>             remove breakpoint\n"
+        "watch <addr> [r|w|rw]     pause before instruction reading/writing addr (default w)\n"
+        "unwatch <addr>            remove watchpoint\n"
+        "cond <V0-VF|I> changed    pause once register changes\n"
+        "cond <V0-VF|I> == <val>   pause once register becomes equal (or != for not equal)\n"
+        "uncond                    remove all register conditions\n"
+        "step                      execute single instruction\n"
+        "next                      like step, but runs 2nnn calls until they return\n"
+        "continue                  resume execution\n"
+        "pause                     pause execution\n"
+        "regs                      print registers\n"
+        "mem <addr> [length]       print memory\n"
+        "list                      print breakpoints, watchpoints and conditions\n"
+        "All values are hexadecimal.";
+
+static std::string FormatHex(unsigned int value, int width)
+{
+    std::stringstream stream;
+    stream << std::uppercase << std::hex << std::setfill('0') << std::setw(width) << value;
+
+    return stream.str();
+}
+
+static uint16_t ParseHexArgument(std::istringstream& stream)
+{
+    std::string token;
+    if (!(stream >> token))
+    {
+        throw std::invalid_argument("Missing argument");
+    }
+
+    return std::stoi(token, nullptr, 16);
+}
+
+static int ParseRegisterName(const std::string& name)
+{
+    if (name == "I" || name == "i")
+    {
+        return DEBUGGER_INDEX_REGISTER;
+    }
+
+    if (name.size() == 2 && (name[0] == 'V' || name[0] == 'v') && isxdigit(name[1]))
+    {
+        return std::stoi(name.substr(1), nullptr, 16);
+    }
+
+    throw std::invalid_argument("Invalid register: " + name);
+}
+
+static std::string FormatRegisterName(int reg)
+{
+    return reg == DEBUGGER_INDEX_REGISTER ? "I" : "V" + FormatHex(reg, 1);
+}
+
+Chip8Debugger::Chip8Debugger(Chip8Interpreter& interpreter, const std::string& socket_path)
+        : _interpreter(interpreter), _socket_path(socket_path)
+{
+    if (_socket_path.empty())
+    {
+        _input_fd = STDIN_FILENO;
+        _output_fd = STDOUT_FILENO;
+
+        Reply("Debugger paused at PC=0x" + FormatHex(_interpreter.GetProgramCounter(), 3) + ", type 'help'");
+
+        return;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (_socket_path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument("Debugger socket path too long: " + _socket_path);
+    }
+
+    _socket_path.copy(address.sun_path, _socket_path.size());
+    unlink(_socket_path.c_str());
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (_listen_fd < 0 || bind(_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(_listen_fd, 1) != 0)
+    {
+        if (_listen_fd >= 0)
+        {
+            close(_listen_fd);
+        }
+
+        throw std::runtime_error("Unable to listen on debugger socket: " + _socket_path);
+    }
+}
+
+Chip8Debugger::~Chip8Debugger()
+{
+    if (_listen_fd >= 0)
+    {
+        if (_input_fd >= 0)
+        {
+            close(_input_fd);
+        }
+
+        close(_listen_fd);
+        unlink(_socket_path.c_str());
+    }
+}
+
+bool Chip8Debugger::IsPaused() const
+{
+    return _paused;
+}
+
+bool Chip8Debugger::IsArmed() const
+{
+    return _stepping || _stepping_over || !_conditions.empty() ||
+           _watchpoints_armed || _breakpoints.any();
+}
+
+void Chip8Debugger::RunInstructions(uint32_t instruction_count)
+{
+    if (_paused)
+    {
+        return;
+    }
+
+    try
+    {
+        if (IsArmed())
+        {
+            RunCheckedInstructions(instruction_count);
+            return;
+        }
+
+        // Nothing to check, same loop as when running without debugger
+        for (uint32_t i = 0; i < instruction_count; i++)
+        {
+            _interpreter.ExecuteNextInstruction();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        Pause(std::string("Exception: ") + e.what());
+    }
+}
+
+void Chip8Debugger::RunCheckedInstructions(uint32_t instruction_count)
+{
+    for (uint32_t i = 0; i < instruction_count; i++)
+    {
+        if (!_resuming && CheckBeforeInstruction(_interpreter.GetProgramCounter()))
+        {
+            return;
+        }
+
+        _resuming = false;
+
+        _interpreter.ExecuteNextInstruction();
+
+        if (CheckAfterInstruction())
+        {
+            return;
+        }
+    }
+}
+
+bool Chip8Debugger::CheckBeforeInstruction(uint16_t pc)
+{
+    if (_breakpoints.test(pc % C8_XO_MEMORY_SIZE))
+    {
+        Pause("Breakpoint");
+        return true;
+    }
+
+    if (_stepping_over && pc == _step_over_pc && _interpreter.GetStackDepth() == _step_over_depth)
+    {
+        Pause("Stepped over call");
+        return true;
+    }
+
+    if (!_watchpoints_armed)
+    {
+        return false;
+    }
+
+    // Decode just enough of the upcoming instruction to know which memory it touches
+    uint16_t opcode = (_interpreter.ReadMemory(pc) << 8) | _interpreter.ReadMemory(pc + 1);
+    int x = DecodeXFromOpcode(opcode);
+    int length = 0;
+    bool write = false;
+
+    bool xo_chip = _interpreter.GetVariant() == Chip8Variant::XOChip;
+
+    if ((opcode & 0xF000) == 0xD000)
+    {
+        // Dxy0 is a 16x16 sprite outside classic CHIP-8, each selected XO-CHIP plane reads its own sprite
+        int sprite_bytes = DecodeNFromOpcode(opcode);
+        if (sprite_bytes == 0 && _interpreter.GetVariant() != Chip8Variant::Chip8)
+        {
+            sprite_bytes = 32;
+        }
+
+        int planes = xo_chip ? std::bitset<C8_PLANE_COUNT>(_interpreter.GetSelectedPlanes()).count() : 1;
+        length = sprite_bytes * planes;
+    }
+    else if (xo_chip && (opcode & 0xF00E) == 0x5002)
+    {
+        length = std::abs(x - DecodeYFromOpcode(opcode)) + 1;
+        write = (opcode & 0x000F) == 0x2;
+    }
+    else if (xo_chip && opcode == 0xF002)
+    {
+        length = 16;
+    }
+    else if ((opcode & 0xF0FF) == 0xF065)
+    {
+        length = x + 1;
+    }
+    else if ((opcode & 0xF0FF) == 0xF033)
+    {
+        length = 3;
+        write = true;
+    }
+    else if ((opcode & 0xF0FF) == 0xF055)
+    {
+        length = x + 1;
+        write = true;
+    }
+
+    auto& watchpoints = write ? _write_watchpoints : _read_watchpoints;
+
+    for (auto offset = 0; offset < length; offset++)
+    {
+        uint16_t address = (_interpreter.GetIndexRegister() + offset) % C8_XO_MEMORY_SIZE;
+
+        if (watchpoints.test(address))
+        {
+            Pause(std::string(write ? "Write" : "Read") + " watchpoint at 0x" + FormatHex(address, 3));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Chip8Debugger::CheckAfterInstruction()
+{
+    if (_stepping)
+    {
+        Pause("Step");
+        return true;
+    }
+
+    for (auto& condition: _conditions)
+    {
+        uint16_t value = condition.reg == DEBUGGER_INDEX_REGISTER ? _interpreter.GetIndexRegister()
+                                                                  : _interpreter.GetGeneralRegister(condition.reg);
+
+        bool result = condition.type == DebuggerConditionType::Changed ? value != condition.last_value :
+                      condition.type == DebuggerConditionType::Equal ? value == condition.value :
+                      value != condition.value;
+
+        // Equality conditions trigger when they become true, not on every instruction they hold
+        bool triggered = result && (condition.type == DebuggerConditionType::Changed || !condition.last_result);
+
+        condition.last_value = value;
+        condition.last_result = result;
+
+        if (triggered)
+        {
+            Pause("Condition on " + FormatRegisterName(condition.reg) + ", now 0x" + FormatHex(value, 2));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Chip8Debugger::Pause(const std::string& reason)
+{
+    _paused = true;
+    _stepping = false;
+    _stepping_over = false;
+
+    uint16_t pc = _interpreter.GetProgramCounter();
+    uint16_t opcode = (_interpreter.ReadMemory(pc) << 8) | _interpreter.ReadMemory(pc + 1);
+
+    Reply("Paused at PC=0x" + FormatHex(pc, 3) + " [" + FormatHex(opcode, 4) + "]: " + reason);
+}
+
+void Chip8Debugger::PollCommands()
+{
+    if (_listen_fd >= 0 && _input_fd < 0)
+    {
+        int client_fd = accept(_listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            return;
+        }
+
+        _input_fd = client_fd;
+        _output_fd = client_fd;
+        _input_buffer.clear();
+
+        Reply(std::string("Debugger ") + (_paused ? "paused" : "running") + " at PC=0x" +
+              FormatHex(_interpreter.GetProgramCounter(), 3) + ", type 'help'");
+    }
+
+    pollfd input_poll{_input_fd, POLLIN, 0};
+
+    while (_input_fd >= 0 && poll(&input_poll, 1, 0) > 0)
+    {
+        char buffer[512];
+        ssize_t read_bytes = read(_input_fd, buffer, sizeof(buffer));
+
+        if (read_bytes <= 0)
+        {
+            // Socket clients can reconnect, nothing could resume after the end of stdin so the debugger detaches
+            // the next time it's paused with no commands left
+            if (_listen_fd >= 0)
+            {
+                close(_input_fd);
+                _input_buffer.clear();
+            }
+            else
+            {
+                _input_buffer += '\n';
+                _stdin_closed = true;
+            }
+
+            _input_fd = -1;
+            _output_fd = _listen_fd >= 0 ? -1 : _output_fd;
+
+            break;
+        }
+
+        _input_buffer.append(buffer, read_bytes);
+    }
+
+    // Commands after step/next/continue wait until execution actually resumed, so scripted sessions work
+    for (auto end = _input_buffer.find('\n'); end != std::string::npos && !_resuming; end = _input_buffer.find('\n'))
+    {
+        std::string line = _input_buffer.substr(0, end);
+        _input_buffer.erase(0, end + 1);
+
+        ExecuteCommand(line);
+    }
+
+    if (_stdin_closed && _paused && !_resuming && _input_buffer.find('\n') == std::string::npos)
+    {
+        Detach();
+    }
+}
+
+void Chip8Debugger::Detach()
+{
+    _stdin_closed = false;
+
+    _breakpoints.reset();
+    _read_watchpoints.reset();
+    _write_watchpoints.reset();
+    _watchpoints_armed = false;
+    _conditions.clear();
+    _stepping = false;
+    _stepping_over = false;
+    _resuming = true;
+    _paused = false;
+
+    Reply("End of input, debugger detached");
+}
+
+void Chip8Debugger::ExecuteCommand(const std::string& line)
+{
+    std::istringstream stream(line);
+    std::string command;
+
+    if (!(stream >> command))
+    {
+        return;
+    }
+
+    try
+    {
+        if (command == "break" || command == "b")
+        {
+            uint16_t address = ParseHexArgument(stream) % C8_XO_MEMORY_SIZE;
+            _breakpoints.set(address);
+            Reply("Breakpoint at 0x" + FormatHex(address, 3));
+        }
+        else if (command == "delete" || command == "d")
+        {
+            _breakpoints.reset(ParseHexArgument(stream) % C8_XO_MEMORY_SIZE);
+        }
+        else if (command == "watch" || command == "w")
+        {
+            uint16_t address = ParseHexArgument(stream) % C8_XO_MEMORY_SIZE;
+            std::string mode = "w";
+            stream >> mode;
+
+            _read_watchpoints.set(address, mode.find('r') != std::string::npos);
+            _write_watchpoints.set(address, mode.find('w') != std::string::npos);
+            _watchpoints_armed = _read_watchpoints.any() || _write_watchpoints.any();
+            Reply("Watchpoint (" + mode + ") at 0x" + FormatHex(address, 3));
+        }
+        else if (command == "unwatch")
+        {
+            uint16_t address = ParseHexArgument(stream) % C8_XO_MEMORY_SIZE;
+            _read_watchpoints.reset(address);
+            _write_watchpoints.reset(address);
+            _watchpoints_armed = _read_watchpoints.any() || _write_watchpoints.any();
+        }
+        else if (command == "cond")
+        {
+            std::string reg_name;
+            std::string operation;
+            stream >> reg_name >> operation;
+
+            DebuggerCondition condition{};
+            condition.reg = ParseRegisterName(reg_name);
+
+            if (operation == "changed")
+            {
+                condition.type = DebuggerConditionType::Changed;
+            }
+            else if (operation == "==" || operation == "!=")
+            {
+                condition.type = operation == "==" ? DebuggerConditionType::Equal : DebuggerConditionType::NotEqual;
+                condition.value = ParseHexArgument(stream);
+            }
+            else
+            {
+                throw std::invalid_argument("Invalid condition: " + operation);
+            }
+
+            condition.last_value = condition.reg == DEBUGGER_INDEX_REGISTER
+                                   ? _interpreter.GetIndexRegister()
+                                   : _interpreter.GetGeneralRegister(condition.reg);
+            condition.last_result = condition.type == DebuggerConditionType::Equal
+                                    ? condition.last_value == condition.value
+                                    : condition.type == DebuggerConditionType::NotEqual &&
+                                      condition.last_value != condition.value;
+
+            _conditions.push_back(condition);
+        }
+        else if (command == "uncond")
+        {
+            _conditions.clear();
+        }
+        else if (command == "step" || command == "s")
+        {
+            _stepping = true;
+            _resuming = true;
+            _paused = false;
+        }
+        else if (command == "next" || command == "n")
+        {
+            uint16_t pc = _interpreter.GetProgramCounter();
+            uint16_t opcode = (_interpreter.ReadMemory(pc) << 8) | _interpreter.ReadMemory(pc + 1);
+
+            // Only 2nnn is stepped over, anything else including the SUPER-CHIP/XO-CHIP 00nn opcodes is single stepped
+            bool is_call = (opcode & 0xF000) == 0x2000;
+
+            _stepping = !is_call;
+            _stepping_over = is_call;
+            _step_over_pc = pc + 2;
+            _step_over_depth = _interpreter.GetStackDepth();
+            _resuming = true;
+            _paused = false;
+        }
+        else if (command == "continue" || command == "c")
+        {
+            _resuming = true;
+            _paused = false;
+        }
+        else if (command == "pause" || command == "p")
+        {
+            Pause("Pause requested");
+        }
+        else if (command == "regs" || command == "r")
+        {
+            PrintRegisters();
+        }
+        else if (command == "mem" || command == "x")
+        {
+            uint16_t address = ParseHexArgument(stream);
+            std::string length = "10";
+            stream >> length;
+
+            PrintMemory(address, std::stoi(length, nullptr, 16));
+        }
+        else if (command == "list" || command == "l")
+        {
+            std::string text;
+
+            for (auto address = 0; address < C8_XO_MEMORY_SIZE; address++)
+            {
+                if (_breakpoints.test(address))
+                {
+                    text += "break 0x" + FormatHex(address, 3) + "\n";
+                }
+
+                if (_read_watchpoints.test(address) || _write_watchpoints.test(address))
+                {
+                    text += "watch 0x" + FormatHex(address, 3) + " " + (_read_watchpoints.test(address) ? "r" : "") +
+                            (_write_watchpoints.test(address) ? "w" : "") + "\n";
+                }
+            }
+
+            for (auto& condition: _conditions)
+            {
+                text += "cond " + FormatRegisterName(condition.reg) +
+                        (condition.type == DebuggerConditionType::Changed ? " changed" :
+                         (condition.type == DebuggerConditionType::Equal ? " == 0x" : " != 0x") +
+                         FormatHex(condition.value, 2)) + "\n";
+            }
+
+            Reply(text.empty() ? "Nothing armed" : text.substr(0, text.size() - 1));
+        }
+        else if (command == "help" || command == "h")
+        {
+            Reply(DEBUGGER_HELP);
+        }
+        else
+        {
+            Reply("Unknown command: " + command + ", type 'help'");
+        }
+    }
+    catch (const std::exception& e)
+    {
+        Reply(std::string("Error: ") + e.what());
+    }
+}
+
+void Chip8Debugger::PrintRegisters()
+{
+    std::string text = "PC=0x" + FormatHex(_interpreter.GetProgramCounter(), 3) +
+                       " I=0x" + FormatHex(_interpreter.GetIndexRegister(), 3) +
+                       " SP=" + std::to_string(_interpreter.GetStackDepth()) + "\n";
+
+    for (auto i = 0; i < 16; i++)
+    {
+        text += "V" + FormatHex(i, 1) + "=" + FormatHex(_interpreter.GetGeneralRegister(i), 2) + (i == 15 ? "" : " ");
+    }
+
+    Reply(text);
+}
+
+void Chip8Debugger::PrintMemory(uint16_t address, int length)
+{
+    // Addresses wrap around like ReadMemory, so nothing past one copy of memory is worth printing
+    int memory_size = _interpreter.GetVariant() == Chip8Variant::XOChip ? C8_XO_MEMORY_SIZE : C8_MEMORY_SIZE;
+    length = std::clamp(length, 0, memory_size);
+
+    std::string text;
+
+    for (auto offset = 0; offset < length; offset++)
+    {
+        if (offset % 16 == 0)
+        {
+            text += (offset == 0 ? "" : "\n") + FormatHex((address + offset) % C8_XO_MEMORY_SIZE, 3) + ":";
+        }
+
+        text += " " + FormatHex(_interpreter.ReadMemory(address + offset), 2);
+    }
+
+    Reply(text);
+}
+
+void Chip8Debugger::Reply(const std::string& text)
+{
+    if (_output_fd < 0)
+    {
+        return;
+    }
+
+    std::string message = text + "\n";
+
+    for (size_t written = 0; written < message.size();)
+    {
+        // Socket clients disconnecting mid reply shouldn't raise SIGPIPE
+        ssize_t result = _listen_fd >= 0
+                         ? send(_output_fd, message.data() + written, message.size() - written, MSG_NOSIGNAL)
+                         : write(_output_fd, message.data() + written, message.size() - written);
+
+        if (result <= 0)
+        {
+            return;
+        }
+
+        written += result;
+    }
+}
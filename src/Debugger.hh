@@ -0,0 +1,86 @@
+#ifndef CALICOC8_DEBUGGER_HH
+#define CALICOC8_DEBUGGER_HH
+
+#include <cstdint>
+#include <bitset>
+#include <string>
+#include <vector>
+#include "Interpreter.hh"
+
+enum class DebuggerConditionType
+{
+    Equal,
+    NotEqual,
+    Changed
+};
+
+struct DebuggerCondition
+{
+    // 0x0-0xF for general registers, 0x10 for I
+    int reg = 0;
+    DebuggerConditionType type = DebuggerConditionType::Changed;
+    uint16_t value = 0;
+
+    uint16_t last_value = 0;
+    bool last_result = false;
+};
+
+// Line based command interface, read from stdin or from a client of a local Unix domain socket.
+// As long as nothing is armed instructions run through the same loop as without debugger.
+class Chip8Debugger
+{
+public:
+    // Empty socket path means stdin/stdout
+    Chip8Debugger(Chip8Interpreter& interpreter, const std::string& socket_path);
+    ~Chip8Debugger();
+
+    Chip8Debugger(const Chip8Debugger&) = delete;
+    Chip8Debugger& operator=(const Chip8Debugger&) = delete;
+
+    void PollCommands();
+    void RunInstructions(uint32_t instruction_count);
+
+    bool IsPaused() const;
+
+private:
+    bool IsArmed() const;
+    void RunCheckedInstructions(uint32_t instruction_count);
+    bool CheckBeforeInstruction(uint16_t pc);
+    bool CheckAfterInstruction();
+
+    void Pause(const std::string& reason);
+    // Drops everything that could pause again and resumes, used once stdin is closed
+    void Detach();
+    void ExecuteCommand(const std::string& line);
+    void PrintRegisters();
+    void PrintMemory(uint16_t address, int length);
+    void Reply(const std::string& text);
+
+    Chip8Interpreter& _interpreter;
+
+    std::bitset<C8_XO_MEMORY_SIZE> _breakpoints;
+    std::bitset<C8_XO_MEMORY_SIZE> _read_watchpoints;
+    std::bitset<C8_XO_MEMORY_SIZE> _write_watchpoints;
+    bool _watchpoints_armed = false;
+    std::vector<DebuggerCondition> _conditions;
+
+    bool _paused = true;
+    bool _stepping = false;
+
+    // Step over target, set while a 2nnn is being stepped over
+    bool _stepping_over = false;
+    uint16_t _step_over_pc = 0;
+    size_t _step_over_depth = 0;
+
+    // Instruction the debugger paused on is executed without checks once resumed
+    bool _resuming = false;
+
+    std::string _socket_path;
+    int _listen_fd = -1;
+    int _input_fd = -1;
+    int _output_fd = -1;
+    std::string _input_buffer;
+    bool _stdin_closed = false;
+};
+
+#endif //CALICOC8_DEBUGGER_HH
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include "Differential.hh"
+
+constexpr size_t DIFF_MAX_REPORTED_MEMORY_BYTES = 8;
+
+static std::string FormatHex(unsigned int value, int width)
+{
+    std::stringstream stream;
+    stream << "0x" << std::uppercase << std::hex << std::setfill('0') << std::setw(width) << value;
+
+    return stream.str();
+}
+
+static std::string FormatDifference(const std::string& field, const std::string& expected, const std::string& actual)
+{
+    return field + ": expected " + expected + ", got " + actual;
+}
+
+class ReferenceEngine : public Chip8Engine
+{
+public:
+    explicit ReferenceEngine(Chip8Variant variant)
+            : _interpreter(variant)
+    {
+    }
+
+    void LoadROM(const std::vector<uint8_t>& binary) override
+    {
+        _interpreter.LoadROM(binary);
+    }
+
+    void SeedRandom(uint32_t seed) override
+    {
+        _interpreter.SeedRandom(seed);
+    }
+
+    void HandleKeyEvent(CalicoEvent event, CalicoKey key) override
+    {
+        _interpreter.HandleKeyEvent(event, key);
+    }
+
+    void ExecuteNextInstruction() override
+    {
+        _interpreter.ExecuteNextInstruction();
+    }
+
+    void TickTimers() override
+    {
+        _interpreter.TickSoundTimer();
+        _interpreter.TickDelayTimer();
+    }
+
+    uint16_t GetProgramCounter() const override
+    {
+        return _interpreter.GetProgramCounter();
+    }
+
+    Chip8MachineState SaveState() const override
+    {
+        return _interpreter.SaveState();
+    }
+
+    std::vector<uint8_t> SaveExtendedMemory() const override
+    {
+        return _interpreter.SaveExtendedMemory();
+    }
+
+protected:
+    Chip8Interpreter _interpreter;
+};
+
+// Reference interpreter going through its trace recording path, traces are thrown away
+class TracedEngine : public ReferenceEngine
+{
+public:
+    explicit TracedEngine(Chip8Variant variant)
+            : ReferenceEngine(variant)
+    {
+        static std::atomic<uint32_t> engine_counter{0};
+
+        _trace_path = (std::filesystem::temp_directory_path() /
+                       ("calico-diff-" + std::to_string(getpid()) + "-" + std::to_string(engine_counter++))).string();
+
+        _interpreter.StartTrace(_trace_path);
+    }
+
+    ~TracedEngine() override
+    {
+        _interpreter.StopTrace();
+
+        for (auto segment = 0; std::filesystem::remove(_trace_path + "." + std::to_string(segment)); segment++)
+        {
+        }
+    }
+
+private:
+    std::string _trace_path;
+};
+
+std::unique_ptr<Chip8Engine> CreateChip8Engine(const std::string& name, Chip8Variant variant)
+{
+    if (name == "reference")
+    {
+        return std::make_unique<ReferenceEngine>(variant);
+    }
+
+    if (name == "traced")
+    {
+        return std::make_unique<TracedEngine>(variant);
+    }
+
+    throw std::invalid_argument("Unknown engine: " + name);
+}
+
+std::vector<std::string> GetChip8EngineNames()
+{
+    return {"reference", "traced"};
+}
+
+std::vector<std::string> DiffMachineStates(const Chip8MachineState& expected, const Chip8MachineState& actual,
+                                           const std::vector<uint8_t>& expected_extended_memory,
+                                           const std::vector<uint8_t>& actual_extended_memory)
+{
+    std::vector<std::string> differences;
+
+    if (expected.pc != actual.pc)
+    {
+        differences.push_back(FormatDifference("PC", FormatHex(expected.pc, 3), FormatHex(actual.pc, 3)));
+    }
+
+    for (auto i = 0; i < 16; i++)
+    {
+        if (expected.general[i] != actual.general[i])
+        {
+            differences.push_back(FormatDifference("V" + FormatHex(i, 1).substr(2),
+                                                   FormatHex(expected.general[i], 2),
+                                                   FormatHex(actual.general[i], 2)));
+        }
+    }
+
+    if (expected.i != actual.i)
+    {
+        differences.push_back(FormatDifference("I", FormatHex(expected.i, 3), FormatHex(actual.i, 3)));
+    }
+
+    if (expected.stack_pointer != actual.stack_pointer)
+    {
+        differences.push_back(FormatDifference("stack depth", std::to_string(expected.stack_pointer),
+                                               std::to_string(actual.stack_pointer)));
+    }
+    else if (expected.stack != actual.stack)
+    {
+        differences.push_back("stack: return addresses differ");
+    }
+
+    if (expected.delay != actual.delay)
+    {
+        differences.push_back(FormatDifference("DT", FormatHex(expected.delay, 2), FormatHex(actual.delay, 2)));
+    }
+
+    if (expected.sound != actual.sound)
+    {
+        differences.push_back(FormatDifference("ST", FormatHex(expected.sound, 2), FormatHex(actual.sound, 2)));
+    }
+
+    if (expected.planes != actual.planes)
+    {
+        differences.push_back(FormatDifference("planes", FormatHex(expected.planes, 1),
+                                               FormatHex(actual.planes, 1)));
+    }
+
+    if (expected.pitch != actual.pitch)
+    {
+        differences.push_back(FormatDifference("pitch", FormatHex(expected.pitch, 2), FormatHex(actual.pitch, 2)));
+    }
+
+    if (expected.audio_pattern != actual.audio_pattern)
+    {
+        differences.push_back("audio pattern: bytes differ");
+    }
+
+    if (expected.rpl_flags != actual.rpl_flags)
+    {
+        differences.push_back("RPL flags: bytes differ");
+    }
+
+    if (expected.keypad_status != actual.keypad_status)
+    {
+        differences.push_back("keypad: pressed keys differ");
+    }
+
+    if (expected.random_state != actual.random_state)
+    {
+        differences.push_back(FormatDifference("random state", FormatHex(expected.random_state, 8),
+                                               FormatHex(actual.random_state, 8)));
+    }
+
+    size_t differing_bytes = 0;
+    for (auto address = 0; address < C8_MEMORY_SIZE; address++)
+    {
+        if (expected.memory[address] != actual.memory[address] &&
+            differing_bytes++ < DIFF_MAX_REPORTED_MEMORY_BYTES)
+        {
+            differences.push_back(FormatDifference("memory[" + FormatHex(address, 3) + "]",
+                                                   FormatHex(expected.memory[address], 2),
+                                                   FormatHex(actual.memory[address], 2)));
+        }
+    }
+
+    if (expected_extended_memory.size() != actual_extended_memory.size())
+    {
+        differences.push_back(FormatDifference("extended memory size",
+                                               std::to_string(expected_extended_memory.size()),
+                                               std::to_string(actual_extended_memory.size())));
+    }
+    else
+    {
+        for (size_t offset = 0; offset < expected_extended_memory.size(); offset++)
+        {
+            if (expected_extended_memory[offset] != actual_extended_memory[offset] &&
+                differing_bytes++ < DIFF_MAX_REPORTED_MEMORY_BYTES)
+            {
+                differences.push_back(FormatDifference("memory[" + FormatHex(C8_MEMORY_SIZE + offset, 4) + "]",
+                                                       FormatHex(expected_extended_memory[offset], 2),
+                                                       FormatHex(actual_extended_memory[offset], 2)));
+            }
+        }
+    }
+
+    if (differing_bytes > DIFF_MAX_REPORTED_MEMORY_BYTES)
+    {
+        differences.push_back("memory: " + std::to_string(differing_bytes - DIFF_MAX_REPORTED_MEMORY_BYTES) +
+                              " more bytes differ");
+    }
+
+    if (expected.frame_buffer.IsHighResolution() != actual.frame_buffer.IsHighResolution())
+    {
+        differences.push_back(FormatDifference("resolution",
+                                               std::to_string(expected.frame_buffer.GetWidth()) + "x" +
+                                               std::to_string(expected.frame_buffer.GetHeight()),
+                                               std::to_string(actual.frame_buffer.GetWidth()) + "x" +
+                                               std::to_string(actual.frame_buffer.GetHeight())));
+    }
+    else if (!(expected.frame_buffer == actual.frame_buffer))
+    {
+        size_t differing_pixels = 0;
+        std::string first_pixel;
+
+        for (auto y = 0; y < expected.frame_buffer.GetHeight(); y++)
+        {
+            for (auto x = 0; x < expected.frame_buffer.GetWidth(); x++)
+            {
+                if (expected.frame_buffer.GetPixelColor(x, y) != actual.frame_buffer.GetPixelColor(x, y) &&
+                    differing_pixels++ == 0)
+                {
+                    first_pixel = std::to_string(x) + "," + std::to_string(y);
+                }
+            }
+        }
+
+        differences.push_back("frame buffer: " + std::to_string(differing_pixels) +
+                              " pixels differ, first at " + first_pixel);
+    }
+
+    // Catches fields added to the state later without a report above, the state has no padding
+    if (differences.empty() && std::memcmp(&expected, &actual, sizeof(expected)) != 0)
+    {
+        auto* expected_bytes = reinterpret_cast<const uint8_t*>(&expected);
+        auto* actual_bytes = reinterpret_cast<const uint8_t*>(&actual);
+        size_t offset = std::mismatch(expected_bytes, expected_bytes + sizeof(expected), actual_bytes).first -
+                        expected_bytes;
+
+        differences.push_back("machine state: bytes differ, first at offset " + std::to_string(offset));
+    }
+
+    return differences;
+}
+
+static std::string ExecuteAndCatch(Chip8Engine& engine)
+{
+    try
+    {
+        engine.ExecuteNextInstruction();
+    }
+    catch (const std::exception& e)
+    {
+        return e.what();
+    }
+
+    return "";
+}
+
+// Random key presses, identical for both engines
+class ScriptedInput
+{
+public:
+    explicit ScriptedInput(uint32_t seed)
+            : _state(seed ^ 0x9E3779B9)
+    {
+    }
+
+    void FeedFrame(Chip8Engine& reference, Chip8Engine& candidate)
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+
+        // Toggle one key about every 8 frames
+        if (_state % 8 != 0)
+        {
+            return;
+        }
+
+        int key_index = (_state >> 8) % 16;
+        _pressed[key_index] = !_pressed[key_index];
+
+        CalicoEvent event = _pressed[key_index] ? CalicoEvent::KeyDown : CalicoEvent::KeyUp;
+        reference.HandleKeyEvent(event, static_cast<CalicoKey>(key_index));
+        candidate.HandleKeyEvent(event, static_cast<CalicoKey>(key_index));
+    }
+
+private:
+    uint32_t _state;
+    std::array<bool, 16> _pressed{0};
+};
+
+static Chip8DifferentialResult RunLockstep(const std::string& candidate_engine_name, const std::vector<uint8_t>& rom,
+                                           const Chip8DifferentialSettings& settings,
+                                           Chip8CompareGranularity granularity, uint64_t max_instructions)
+{
+    auto reference = CreateChip8Engine("reference", settings.variant);
+    auto candidate = CreateChip8Engine(candidate_engine_name, settings.variant);
+    ScriptedInput input(settings.seed);
+
+    for (auto* engine: {reference.get(), candidate.get()})
+    {
+        engine->LoadROM(rom);
+        engine->SeedRandom(settings.seed);
+    }
+
+    Chip8DifferentialResult result{};
+
+    while (result.instructions < max_instructions)
+    {
+        if (result.instructions % settings.instructions_per_frame == 0)
+        {
+            input.FeedFrame(*reference, *candidate);
+        }
+
+        uint16_t pc = reference->GetProgramCounter();
+
+        std::string reference_error = ExecuteAndCatch(*reference);
+        std::string candidate_error = ExecuteAndCatch(*candidate);
+
+        result.instructions++;
+
+        bool frame_end = result.instructions % settings.instructions_per_frame == 0;
+        if (frame_end && reference_error.empty())
+        {
+            reference->TickTimers();
+            candidate->TickTimers();
+            result.frames++;
+        }
+
+        if (reference_error != candidate_error)
+        {
+            result.diverged = true;
+            result.pc = pc;
+            result.differences.push_back(FormatDifference("exception", '"' + reference_error + '"',
+                                                          '"' + candidate_error + '"'));
+
+            return result;
+        }
+
+        bool compare = frame_end || !reference_error.empty() ||
+                       granularity == Chip8CompareGranularity::Instruction ||
+                       (granularity == Chip8CompareGranularity::Block &&
+                        reference->GetProgramCounter() != static_cast<uint16_t>(pc + 2));
+
+        if (compare)
+        {
+            result.differences = DiffMachineStates(reference->SaveState(), candidate->SaveState(),
+                                                   reference->SaveExtendedMemory(), candidate->SaveExtendedMemory());
+
+            if (!result.differences.empty())
+            {
+                result.diverged = true;
+                result.pc = pc;
+
+                return result;
+            }
+        }
+
+        // Both engines failed the same way, nothing more to compare
+        if (!reference_error.empty())
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+Chip8DifferentialResult RunDifferential(const std::string& candidate_engine_name, const std::vector<uint8_t>& rom,
+                                        const Chip8DifferentialSettings& settings)
+{
+    auto result = RunLockstep(candidate_engine_name, rom, settings, settings.granularity, settings.max_instructions);
+
+    if (!result.diverged || settings.granularity == Chip8CompareGranularity::Instruction)
+    {
+        return result;
+    }
+
+    // Coarse comparison only tells divergence happened since last check, runs are deterministic
+    // so replaying up to that point while checking every instruction finds the exact one
+    auto narrowed_result = RunLockstep(candidate_engine_name, rom, settings, Chip8CompareGranularity::Instruction,
+                                       result.instructions);
+
+    return narrowed_result.diverged ? narrowed_result : result;
+}
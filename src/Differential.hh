@@ -0,0 +1,69 @@
+#ifndef CALICOC8_DIFFERENTIAL_HH
+#define CALICOC8_DIFFERENTIAL_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Interpreter.hh"
+
+enum class Chip8CompareGranularity
+{
+    Instruction,
+    // After every instruction that didn't continue to PC+2 (jumps, calls, returns, skips)
+    Block,
+    Frame
+};
+
+// Execution engine run in lockstep against the reference one, every engine needs to implement it
+class Chip8Engine
+{
+public:
+    virtual ~Chip8Engine() = default;
+
+    virtual void LoadROM(const std::vector<uint8_t>& binary) = 0;
+    virtual void SeedRandom(uint32_t seed) = 0;
+    virtual void HandleKeyEvent(CalicoEvent event, CalicoKey key) = 0;
+    virtual void ExecuteNextInstruction() = 0;
+    virtual void TickTimers() = 0;
+
+    virtual uint16_t GetProgramCounter() const = 0;
+    virtual Chip8MachineState SaveState() const = 0;
+    // XO-CHIP memory above 4 KB, empty for other variants
+    virtual std::vector<uint8_t> SaveExtendedMemory() const = 0;
+};
+
+std::unique_ptr<Chip8Engine> CreateChip8Engine(const std::string& name, Chip8Variant variant = Chip8Variant::Chip8);
+std::vector<std::string> GetChip8EngineNames();
+
+struct Chip8DifferentialSettings
+{
+    Chip8Variant variant = Chip8Variant::Chip8;
+    Chip8CompareGranularity granularity = Chip8CompareGranularity::Frame;
+    uint64_t max_instructions = 1'000'000;
+    uint32_t instructions_per_frame = 10;
+
+    // Seeds both Cxnn and the scripted key presses fed to both engines
+    uint32_t seed = 1;
+};
+
+struct Chip8DifferentialResult
+{
+    bool diverged = false;
+    uint64_t instructions = 0;
+    uint64_t frames = 0;
+
+    // Filled on divergence, narrowed down to the first instruction after which states differ
+    uint16_t pc = 0x000;
+    std::vector<std::string> differences;
+};
+
+// Field by field report, anything else differing in the raw state is reported at the end as well
+std::vector<std::string> DiffMachineStates(const Chip8MachineState& expected, const Chip8MachineState& actual,
+                                           const std::vector<uint8_t>& expected_extended_memory = {},
+                                           const std::vector<uint8_t>& actual_extended_memory = {});
+
+Chip8DifferentialResult RunDifferential(const std::string& candidate_engine_name, const std::vector<uint8_t>& rom,
+                                        const Chip8DifferentialSettings& settings);
+
+#endif //CALICOC8_DIFFERENTIAL_HH
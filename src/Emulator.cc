@@ -1,40 +1,20 @@
+#include <algorithm>
+#include <chrono>
 #include <exception>
+#include <future>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <thread>
 #include "Emulator.hh"
 
-std::vector<uint8_t> ReadBinaryToVector(const std::string& path)
-{
-    std::ifstream file(path, std::ios::binary);
-    if (!file.good())
-    {
-        throw std::invalid_argument("Invalid ROM path: " + path);
-    }
-
-    file.unsetf(std::ios::skipws);
-
-    file.seekg(0, std::ios::end);
-    std::streampos file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    std::vector<uint8_t> vec;
-    vec.reserve(file_size);
-
-    vec.insert(vec.begin(),
-               std::istream_iterator<uint8_t>(file),
-               std::istream_iterator<uint8_t>());
-
-    return vec;
-}
-
 Emulator::Emulator(const ApplicationCmdSettings& args)
-        : _args(args)
+        : _interpreter(std::make_unique<Chip8Interpreter>(args.variant)),
+          _args(args)
 {
 }
 
 // Used to keep interpreter as separate module from SDL
-static CalicoEvent TranslateSDLEventToCalicoEvent(uint32_t sdl_event_type)
+CalicoEvent TranslateSDLEventToCalicoEvent(uint32_t sdl_event_type)
 {
     switch (sdl_event_type)
     {
@@ -49,62 +29,12 @@ static CalicoEvent TranslateSDLEventToCalicoEvent(uint32_t sdl_event_type)
     }
 }
 
-// Used to keep interpreter as separate module from SDL
-static CalicoKey TranslateSDLKeyToCalicoKey(SDL_Keycode sdl_key)
+// Used to keep interpreter as separate module from SDL, letter and digit keycodes are their characters
+CalicoKey TranslateSDLKeyToCalicoKey(SDL_Keycode sdl_key, const std::string& keymap)
 {
-    switch (sdl_key)
-    {
-        case SDLK_1:
-            return CalicoKey::MK1;
-
-        case SDLK_2:
-            return CalicoKey::MK2;
-
-        case SDLK_3:
-            return CalicoKey::MK3;
-
-        case SDLK_4:
-            return CalicoKey::MK4;
-
-        case SDLK_q:
-            return CalicoKey::Q;
-
-        case SDLK_w:
-            return CalicoKey::W;
-
-        case SDLK_e:
-            return CalicoKey::E;
-
-        case SDLK_r:
-            return CalicoKey::R;
-
-        case SDLK_a:
-            return CalicoKey::A;
-
-        case SDLK_s:
-            return CalicoKey::S;
-
-        case SDLK_d:
-            return CalicoKey::D;
-
-        case SDLK_f:
-            return CalicoKey::F;
-
-        case SDLK_z:
-            return CalicoKey::Z;
-
-        case SDLK_x:
-            return CalicoKey::X;
+    size_t key_index = sdl_key > 0 && sdl_key < 128 ? keymap.find(static_cast<char>(sdl_key)) : std::string::npos;
 
-        case SDLK_c:
-            return CalicoKey::C;
-
-        case SDLK_v:
-            return CalicoKey::V;
-
-        default:
-            return CalicoKey::Invalid;
-    }
+    return key_index == std::string::npos ? CalicoKey::Invalid : static_cast<CalicoKey>(key_index);
 }
 
 static void SDLAudioCallBack(void* user_data, Uint8* raw_buffer, int bytes)
@@ -120,26 +50,19 @@ static void SDLAudioCallBack(void* user_data, Uint8* raw_buffer, int bytes)
     }
 }
 
-int Emulator::InitSDL()
+// Positive result means there's no display to open a window on
+int Emulator::InitVideo()
 {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0)
     {
         _sdl_error_message = SDL_GetError();
-        return -1;
+        return 1;
     }
 
-    SDL_AudioSpec audio_spec_request;
-    audio_spec_request.freq = 44100;
-    audio_spec_request.format = AUDIO_S16SYS;
-    audio_spec_request.channels = 1;
-    audio_spec_request.samples = 2048;
-    audio_spec_request.callback = SDLAudioCallBack;
-    audio_spec_request.userdata = &_audio_sample_number;
-
-    if (SDL_OpenAudio(&audio_spec_request, &_audio_spec) != 0)
+    if (SDL_GetNumVideoDisplays() < 1)
     {
-        _sdl_error_message = SDL_GetError();
-        return -2;
+        _sdl_error_message = "No video displays";
+        return 1;
     }
 
     _window = SDL_CreateWindow("CalicoC8", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
@@ -157,19 +80,65 @@ int Emulator::InitSDL()
         return -3;
     }
 
-    _frame_buffer_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ABGR8888,
-                                              SDL_TEXTUREACCESS_STATIC, 64, 32);
+    // Texture follows the frame buffer size, which the first frame may still change while this runs
+    return 0;
+}
+
+// Opened on the first beep, most ROMs run a while before making any sound and some never do
+int Emulator::InitAudio()
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        _sdl_error_message = SDL_GetError();
+        return -1;
+    }
+
+    SDL_AudioSpec audio_spec_request;
+    audio_spec_request.freq = 44100;
+    audio_spec_request.format = AUDIO_S16SYS;
+    audio_spec_request.channels = 1;
+    audio_spec_request.samples = 2048;
+    audio_spec_request.callback = SDLAudioCallBack;
+    audio_spec_request.userdata = &_audio_sample_number;
+
+    if (SDL_OpenAudio(&audio_spec_request, &_audio_spec) != 0)
+    {
+        _sdl_error_message = SDL_GetError();
+        return -2;
+    }
+
+    _audio_opened = true;
+
+    return 0;
+}
+
+int Emulator::CreateFrameBufferTexture()
+{
+    const auto& frame_buffer = _interpreter->AccessFrameBuffer();
+
+    SDL_DestroyTexture(_frame_buffer_texture);
+
+    _frame_buffer_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STATIC,
+                                              frame_buffer.GetWidth(), frame_buffer.GetHeight());
     if (_frame_buffer_texture == nullptr)
     {
         _sdl_error_message = "Unable to create SDL Texture for frame buffer";
         return -4;
     }
 
+    _frame_buffer_texture_width = frame_buffer.GetWidth();
+    _frame_buffer_pixels.resize(frame_buffer.GetWidth() * frame_buffer.GetHeight());
+
     return 0;
 }
 
 void Emulator::CleanupSDL()
 {
+    if (_audio_opened)
+    {
+        SDL_CloseAudio();
+    }
+
     SDL_DestroyTexture(_frame_buffer_texture);
     SDL_DestroyRenderer(_renderer);
     SDL_DestroyWindow(_window);
@@ -178,29 +147,194 @@ void Emulator::CleanupSDL()
 
 int Emulator::Run(const std::string& rom_path)
 {
+    _run_start = std::chrono::steady_clock::now();
+
     try
     {
-        _interpreter->LoadROM(ReadBinaryToVector(rom_path));
+        Chip8RomMapping rom(rom_path);
+        _interpreter->LoadROM(rom.GetData(), rom.GetSize());
+
+        if (!_args.trace_path.empty())
+        {
+            _interpreter->StartTrace(_args.trace_path);
+        }
+
+        if (_args.debugger_enabled)
+        {
+            _debugger = std::make_unique<Chip8Debugger>(*_interpreter, _args.debugger_socket_path);
+        }
+
+        if (!_args.export_video_path.empty() || !_args.export_audio_path.empty())
+        {
+            _exporter = std::make_unique<Chip8Exporter>(
+                    Chip8ExportSettings{_args.export_video_path, _args.export_audio_path, _args.export_scale});
+        }
+
+        if (!_args.shared_frames_name.empty())
+        {
+            _shared_frames = std::make_unique<Chip8SharedFramePublisher>(_args.shared_frames_name);
+        }
     }
-    catch (const std::invalid_argument& e)
+    catch (const std::exception& e)
     {
         std::cout << e.what() << std::endl;
 
         return -1;
     }
 
+    int result = _args.headless ? RunHeadless() : RunWindowed();
+
+    if (_exporter != nullptr)
+    {
+        try
+        {
+            _exporter->Finish();
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << e.what() << std::endl;
+
+            result = result != 0 ? result : -3;
+        }
+    }
+
+    return result;
+}
 
-    int init_sdl_res = InitSDL();
-    if (init_sdl_res != 0)
+int Emulator::EmulateFrame()
+{
+    if (_debugger != nullptr)
+    {
+        _debugger->PollCommands();
+        _debugger->RunInstructions(_args.clock_speed / 60);
+    }
+    else
+    {
+        // Ex. 600 hz clock speed (600hz / 60fps = 10 instructions per second)
+        for (auto i = 0; i < _args.clock_speed / 60; i++)
+        {
+            try
+            {
+                _interpreter->ExecuteNextInstruction();
+            }
+            catch (const std::exception& e)
+            {
+                std::cout << e.what();
+
+                return -2;
+            }
+        }
+    }
+
+    // Time stands still while paused in debugger
+    if (_debugger == nullptr || !_debugger->IsPaused())
+    {
+        _interpreter->TickSoundTimer();
+        _interpreter->TickDelayTimer();
+    }
+
+    if (_exporter != nullptr)
+    {
+        try
+        {
+            _exporter->SubmitFrame(_interpreter->AccessFrameBuffer(), _interpreter->ShouldPlaySound());
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << e.what() << std::endl;
+
+            return -3;
+        }
+    }
+
+    if (_shared_frames != nullptr)
+    {
+        _shared_frames->Publish(_interpreter->AccessFrameBuffer(), _interpreter->GetProgramCounter(),
+                                _interpreter->GetIndexRegister(), _interpreter->GetDelayTimer(),
+                                _interpreter->GetSoundTimer());
+    }
+
+    _emulated_frames++;
+
+    return 0;
+}
+
+void Emulator::ReportFirstFrame() const
+{
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _run_start).count();
+
+    std::cout << "Time to first frame: " << milliseconds << " ms" << std::endl;
+}
+
+// No window or audio, runs as fast as the exporter keeps up unless capped to 60 frames per second
+int Emulator::RunHeadless(bool frame_cap)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto next_frame = start;
+
+    while (_args.frame_limit == 0 || _emulated_frames < _args.frame_limit)
+    {
+        int frame_result = EmulateFrame();
+        if (frame_result != 0)
+        {
+            return frame_result;
+        }
+
+        if (_emulated_frames == 1)
+        {
+            ReportFirstFrame();
+        }
+
+        if (frame_cap)
+        {
+            next_frame = std::max(next_frame + std::chrono::microseconds(16667), std::chrono::steady_clock::now());
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Emulated " << _emulated_frames << " frames in " << seconds << " s ("
+              << _emulated_frames / 60.0 / seconds << "x real time)" << std::endl;
+
+    return 0;
+}
+
+int Emulator::RunWindowed()
+{
+    // SDL video has to stay on the main thread, so the first frame is emulated on a worker meanwhile
+    auto first_frame = std::async(std::launch::async, &Emulator::EmulateFrame, this);
+
+    int init_video_result = InitVideo();
+    int first_frame_result = first_frame.get();
+
+    if (init_video_result > 0 && first_frame_result == 0)
+    {
+        CleanupSDL();
+
+        std::cout << "No display available (" << _sdl_error_message << "), running headless" << std::endl;
+        ReportFirstFrame();
+
+        // Still meant to be played in real time, only -headless runs unthrottled
+        return RunHeadless(true);
+    }
+
+    if (init_video_result != 0 || first_frame_result != 0)
     {
         CleanupSDL();
 
-        std::cout << "Error: " << _sdl_error_message << std::endl;
+        if (init_video_result != 0)
+        {
+            std::cout << "Error: " << _sdl_error_message << std::endl;
+        }
 
-        return init_sdl_res;
+        return first_frame_result != 0 ? first_frame_result : init_video_result;
     }
 
-    while (_main_loop_running)
+    bool first_frame_pending = true;
+
+    while (_main_loop_running &&
+           (first_frame_pending || _args.frame_limit == 0 || _emulated_frames < _args.frame_limit))
     {
         uint64_t start = SDL_GetPerformanceCounter();
 
@@ -213,27 +347,24 @@ int Emulator::Run(const std::string& rom_path)
             else if (_event.type == SDL_KEYDOWN || _event.type == SDL_KEYUP)
             {
                 _interpreter->HandleKeyEvent(TranslateSDLEventToCalicoEvent(_event.type),
-                                             TranslateSDLKeyToCalicoKey(_event.key.keysym.sym));
+                                             TranslateSDLKeyToCalicoKey(_event.key.keysym.sym, _args.keymap));
             }
         }
 
-        // Ex. 600 hz clock speed (600hz / 60fps = 10 instructions per second)
-        for (auto i = 0; i < _args.clock_speed / 60; i++)
+        int frame_result = first_frame_pending ? 0 : EmulateFrame();
+        if (frame_result != 0)
         {
-            try
-            {
-                _interpreter->ExecuteNextInstruction();
-            }
-            catch (const std::exception& e)
-            {
-                std::cout << e.what();
+            CleanupSDL();
 
-                return -2;
-            }
+            return frame_result;
         }
 
-        _interpreter->TickSoundTimer();
-        _interpreter->TickDelayTimer();
+        if (_interpreter->ShouldPlaySound() && _args.sound_enabled && !_audio_opened && InitAudio() != 0)
+        {
+            std::cout << "Unable to open audio (" << _sdl_error_message << "), sound disabled" << std::endl;
+
+            _args.sound_enabled = false;
+        }
 
         if (_interpreter->ShouldPlaySound() && _args.sound_enabled)
         {
@@ -242,10 +373,23 @@ int Emulator::Run(const std::string& rom_path)
             SDL_PauseAudio(1);
         }
 
-        if (_interpreter->DrawFlag())
+        // Window shows up with the first frame even when nothing was drawn yet
+        if (_interpreter->DrawFlag() || first_frame_pending)
         {
-            SDL_UpdateTexture(_frame_buffer_texture, nullptr, _interpreter->AccessFrameBuffer().GetSDLPixelArray(),
-                              64 * sizeof(uint32_t));
+            const auto& frame_buffer = _interpreter->AccessFrameBuffer();
+
+            if (frame_buffer.GetWidth() != _frame_buffer_texture_width && CreateFrameBufferTexture() != 0)
+            {
+                std::cout << "Error: " << _sdl_error_message << std::endl;
+
+                CleanupSDL();
+
+                return -4;
+            }
+
+            frame_buffer.RenderRGBA(_frame_buffer_pixels.data());
+            SDL_UpdateTexture(_frame_buffer_texture, nullptr, _frame_buffer_pixels.data(),
+                              frame_buffer.GetWidth() * sizeof(uint32_t));
 
             SDL_RenderClear(_renderer);
             SDL_RenderCopy(_renderer, _frame_buffer_texture, nullptr, nullptr);
@@ -254,6 +398,13 @@ int Emulator::Run(const std::string& rom_path)
             _interpreter->DrawFlag(false);
         }
 
+        if (first_frame_pending)
+        {
+            ReportFirstFrame();
+
+            first_frame_pending = false;
+        }
+
         uint64_t end = SDL_GetPerformanceCounter();
 
         float elapsedMS = (float) (end - start) / (float) SDL_GetPerformanceFrequency() * 1000.0f;
@@ -2,13 +2,20 @@
 #define CALICOC8_EMULATOR_HH
 
 #include <SDL2/SDL.h>
+#include <chrono>
 #include <vector>
 #include <string>
 #include <memory>
 #include "CommandLine.hh"
+#include "Debugger.hh"
+#include "Export.hh"
 #include "Interpreter.hh"
+#include "RomFile.hh"
+#include "SharedFrames.hh"
 
-std::vector<uint8_t> ReadBinaryToVector(const std::string& path);
+// Also used by the grid viewer, keymap as in ApplicationCmdSettings
+CalicoEvent TranslateSDLEventToCalicoEvent(uint32_t sdl_event_type);
+CalicoKey TranslateSDLKeyToCalicoKey(SDL_Keycode sdl_key, const std::string& keymap);
 
 class Emulator
 {
@@ -18,20 +25,41 @@ public:
     int Run(const std::string& rom_path);
 
 private:
-    int InitSDL();
+    // Window and audio are only set up once they are needed, see RunWindowed
+    int InitVideo();
+    int InitAudio();
+    int CreateFrameBufferTexture();
     void CleanupSDL();
 
-    std::unique_ptr<Chip8Interpreter> _interpreter = std::make_unique<Chip8Interpreter>();
+    int RunWindowed();
+    int RunHeadless(bool frame_cap = false);
+
+    // Measured from the start of Run, includes loading the ROM and opening the window
+    void ReportFirstFrame() const;
+
+    // Instructions, timers and export of a single 60hz frame
+    int EmulateFrame();
+
+    std::unique_ptr<Chip8Interpreter> _interpreter;
+    std::unique_ptr<Chip8Debugger> _debugger;
+    std::unique_ptr<Chip8Exporter> _exporter;
+    std::unique_ptr<Chip8SharedFramePublisher> _shared_frames;
 
     ApplicationCmdSettings _args;
 
     bool _main_loop_running = true;
+    uint64_t _emulated_frames = 0;
+    std::chrono::steady_clock::time_point _run_start;
 
     SDL_Window* _window = nullptr;
     SDL_Renderer* _renderer = nullptr;
+    // Recreated whenever the frame buffer resolution changes
     SDL_Texture* _frame_buffer_texture = nullptr;
+    std::vector<uint32_t> _frame_buffer_pixels;
+    int _frame_buffer_texture_width = 0;
     SDL_Event _event{};
     SDL_AudioSpec _audio_spec{};
+    bool _audio_opened = false;
     std::string _sdl_error_message;
     int _audio_sample_number = 0;
 };
@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Analyzer.hh"
+#include "Explorer.hh"
+
+// Frontier states are kept as the byte runs where they differ from the power on state. A full state is over 6 KB
+// while steps usually touch a few registers, some memory and part of the screen.
+struct ExplorerNode
+{
+    std::vector<uint8_t> state_delta;
+    std::vector<uint8_t> inputs;
+};
+
+// Each run is a 16 bit offset and length followed by the bytes
+constexpr size_t EXPLORER_RUN_HEADER_SIZE = 2 * sizeof(uint16_t);
+static_assert(sizeof(Chip8MachineState) <= UINT16_MAX, "Run offsets are 16 bit");
+
+// Insert-only open addressing set of 64 bit hashes, zero marks an empty slot.
+// Full states are not stored, two different states colliding on 64 bits is not a practical concern.
+class ConcurrentHashSet
+{
+public:
+    explicit ConcurrentHashSet(size_t max_entries)
+    {
+        // At most half full, probe sequences stay short
+        while (_capacity < max_entries * 2)
+        {
+            _capacity *= 2;
+        }
+
+        _slots = std::make_unique<std::atomic<uint64_t>[]>(_capacity);
+
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            _slots[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // True when the hash was not there before
+    bool Insert(uint64_t hash)
+    {
+        hash = hash != 0 ? hash : 1;
+
+        for (size_t slot = hash & (_capacity - 1);; slot = (slot + 1) & (_capacity - 1))
+        {
+            uint64_t current = _slots[slot].load(std::memory_order_relaxed);
+
+            if (current == 0 &&
+                _slots[slot].compare_exchange_strong(current, hash, std::memory_order_relaxed))
+            {
+                return true;
+            }
+
+            if (current == hash)
+            {
+                return false;
+            }
+        }
+    }
+
+private:
+    size_t _capacity = 1024;
+    std::unique_ptr<std::atomic<uint64_t>[]> _slots;
+};
+
+// Each worker takes from the back of its own queue and steals from the front of the others
+class WorkStealingQueues
+{
+public:
+    explicit WorkStealingQueues(size_t worker_count)
+            : _queues(worker_count)
+    {
+    }
+
+    void Push(size_t worker, ExplorerNode&& node)
+    {
+        std::lock_guard<std::mutex> lock(_queues[worker].mutex);
+        _queues[worker].nodes.push_back(std::move(node));
+    }
+
+    bool Pop(size_t worker, ExplorerNode& node)
+    {
+        for (size_t offset = 0; offset < _queues.size(); offset++)
+        {
+            auto& queue = _queues[(worker + offset) % _queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (queue.nodes.empty())
+            {
+                continue;
+            }
+
+            if (offset == 0)
+            {
+                node = std::move(queue.nodes.back());
+                queue.nodes.pop_back();
+            }
+            else
+            {
+                node = std::move(queue.nodes.front());
+                queue.nodes.pop_front();
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<ExplorerNode> nodes;
+    };
+
+    std::vector<WorkerQueue> _queues;
+};
+
+struct ExplorerWorker
+{
+    Chip8Interpreter interpreter;
+    Chip8MachineState node_state;
+    Chip8MachineState child_state;
+    std::vector<uint8_t> state_delta;
+    std::vector<ExplorerNode> next_level;
+    std::bitset<C8_MEMORY_SIZE> covered_pcs;
+    size_t expanded_states = 0;
+    size_t pruned_states = 0;
+    size_t faulted_states = 0;
+};
+
+static uint64_t MixHash(uint64_t hash, const uint8_t* data, size_t length)
+{
+    size_t offset = 0;
+
+    for (; offset + sizeof(uint64_t) <= length; offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + offset, sizeof(word));
+
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15;
+        hash ^= hash >> 32;
+    }
+
+    for (; offset < length; offset++)
+    {
+        hash = (hash ^ data[offset]) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+static uint64_t FinalizeHash(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCD;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+uint64_t HashFrameBuffer(const Chip8FrameBuffer& frame_buffer)
+{
+    uint8_t high_resolution = frame_buffer.IsHighResolution();
+    uint64_t hash = MixHash(0xCBF29CE484222325, &high_resolution, sizeof(high_resolution));
+
+    return FinalizeHash(MixHash(hash, frame_buffer.GetPackedData(), Chip8FrameBuffer::GetPackedSize()));
+}
+
+// Keypad is overwritten by the next input before anything runs, so states differing only in held keys behave
+// the same. RNG state is excluded as well, otherwise every Cxnn would make otherwise equal states unique.
+// Both sit next to each other in the flat state, everything around them is hashed as two contiguous ranges.
+static_assert(offsetof(Chip8MachineState, keypad_status) == offsetof(Chip8MachineState, random_state) + 4 &&
+              offsetof(Chip8MachineState, rpl_flags) == offsetof(Chip8MachineState, keypad_status) + 16,
+              "Unhashed fields need to be adjacent");
+
+uint64_t HashMachineState(const Chip8MachineState& state)
+{
+    auto* bytes = reinterpret_cast<const uint8_t*>(&state);
+
+    uint64_t hash = MixHash(0xCBF29CE484222325, bytes, offsetof(Chip8MachineState, random_state));
+    hash = MixHash(hash, bytes + offsetof(Chip8MachineState, rpl_flags),
+                   sizeof(Chip8MachineState) - offsetof(Chip8MachineState, rpl_flags));
+
+    return FinalizeHash(hash);
+}
+
+static void EncodeStateDelta(const Chip8MachineState& base, const Chip8MachineState& state,
+                             std::vector<uint8_t>& delta)
+{
+    auto* base_bytes = reinterpret_cast<const uint8_t*>(&base);
+    auto* bytes = reinterpret_cast<const uint8_t*>(&state);
+    delta.clear();
+
+    for (size_t offset = 0; offset < sizeof(state);)
+    {
+        // Untouched memory is skipped a word at a time
+        if (offset + sizeof(uint64_t) <= sizeof(state) &&
+            std::memcmp(bytes + offset, base_bytes + offset, sizeof(uint64_t)) == 0)
+        {
+            offset += sizeof(uint64_t);
+            continue;
+        }
+
+        if (bytes[offset] == base_bytes[offset])
+        {
+            offset++;
+            continue;
+        }
+
+        // Equal gaps shorter than a run header are cheaper to store than to start a new run
+        size_t end = offset + 1;
+        for (size_t scan = end; scan < sizeof(state) && scan - end < EXPLORER_RUN_HEADER_SIZE; scan++)
+        {
+            if (bytes[scan] != base_bytes[scan])
+            {
+                end = scan + 1;
+            }
+        }
+
+        uint16_t header[2] = {static_cast<uint16_t>(offset), static_cast<uint16_t>(end - offset)};
+        auto* header_bytes = reinterpret_cast<const uint8_t*>(header);
+
+        delta.insert(delta.end(), header_bytes, header_bytes + sizeof(header));
+        delta.insert(delta.end(), bytes + offset, bytes + end);
+
+        offset = end;
+    }
+}
+
+static void DecodeStateDelta(const Chip8MachineState& base, const std::vector<uint8_t>& delta,
+                             Chip8MachineState& state)
+{
+    auto* bytes = reinterpret_cast<uint8_t*>(&state);
+    state = base;
+
+    for (size_t position = 0; position < delta.size();)
+    {
+        uint16_t header[2];
+        std::memcpy(header, delta.data() + position, sizeof(header));
+        position += sizeof(header);
+
+        std::memcpy(bytes + header[0], delta.data() + position, header[1]);
+        position += header[1];
+    }
+}
+
+static void ApplyInput(Chip8Interpreter& interpreter, uint8_t input)
+{
+    for (auto key = 0; key < 16; key++)
+    {
+        interpreter.HandleKeyEvent(key == input ? CalicoEvent::KeyDown : CalicoEvent::KeyUp,
+                                   static_cast<CalicoKey>(key));
+    }
+}
+
+// Runs one exploration step with the input held, throws whatever the interpreter throws
+static void RunStep(Chip8Interpreter& interpreter, const Chip8ExplorerSettings& settings,
+                    std::bitset<C8_MEMORY_SIZE>& covered_pcs)
+{
+    for (uint32_t frame = 0; frame < settings.frames_per_input; frame++)
+    {
+        for (uint32_t instruction = 0; instruction < settings.instructions_per_frame; instruction++)
+        {
+            covered_pcs.set(interpreter.GetProgramCounter() % C8_MEMORY_SIZE);
+            interpreter.ExecuteNextInstruction();
+        }
+
+        interpreter.TickSoundTimer();
+        interpreter.TickDelayTimer();
+    }
+}
+
+static void PowerOn(Chip8Interpreter& interpreter, const std::vector<uint8_t>& rom, uint32_t seed)
+{
+    interpreter.LoadROM(rom);
+    interpreter.SeedRandom(seed);
+}
+
+Chip8ExplorationStats ExploreROM(const std::vector<uint8_t>& rom, const Chip8ExplorerSettings& settings,
+                                 const std::function<void(const Chip8ExploredState&)>& on_new_state)
+{
+    auto start_time = std::chrono::steady_clock::now();
+
+    Chip8ExplorationStats stats{};
+    ConcurrentHashSet visited_states(settings.max_states);
+    ConcurrentHashSet visited_screens(settings.max_states);
+    std::atomic<size_t> unique_states{0};
+    std::atomic<size_t> unique_screens{0};
+    std::mutex report_mutex;
+
+    auto report = [&](const Chip8MachineState& state, uint64_t state_hash, const std::vector<uint8_t>& inputs)
+    {
+        Chip8ExploredState explored{state_hash, HashFrameBuffer(state.frame_buffer), false, inputs};
+        explored.new_screen = visited_screens.Insert(explored.frame_buffer_hash);
+
+        if (explored.new_screen)
+        {
+            unique_screens++;
+        }
+
+        std::lock_guard<std::mutex> lock(report_mutex);
+        on_new_state(explored);
+    };
+
+    // Root node has an empty delta
+    std::vector<ExplorerNode> frontier(1);
+    Chip8Interpreter root_interpreter;
+    PowerOn(root_interpreter, rom, settings.seed);
+    const Chip8MachineState root_state = root_interpreter.SaveState();
+
+    uint64_t root_hash = HashMachineState(root_state);
+    visited_states.Insert(root_hash);
+    unique_states++;
+    report(root_state, root_hash, frontier[0].inputs);
+    stats.states_per_depth.push_back(1);
+
+    unsigned int worker_count = std::max(1u, settings.threads);
+    std::vector<std::unique_ptr<ExplorerWorker>> workers;
+
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        workers.push_back(std::make_unique<ExplorerWorker>());
+    }
+
+    for (uint32_t depth = 0; depth < settings.max_depth && !frontier.empty(); depth++)
+    {
+        WorkStealingQueues queues(worker_count);
+
+        for (size_t i = 0; i < frontier.size(); i++)
+        {
+            queues.Push(i % worker_count, std::move(frontier[i]));
+        }
+
+        frontier.clear();
+        std::vector<std::thread> threads;
+
+        for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++)
+        {
+            threads.emplace_back([&, worker_index]
+                                 {
+                                     auto& worker = *workers[worker_index];
+                                     ExplorerNode node;
+
+                                     while (unique_states < settings.max_states && queues.Pop(worker_index, node))
+                                     {
+                                         worker.expanded_states++;
+                                         DecodeStateDelta(root_state, node.state_delta, worker.node_state);
+
+                                         for (uint8_t input = 0; input < EXPLORER_INPUT_COUNT; input++)
+                                         {
+                                             worker.interpreter.LoadState(worker.node_state);
+                                             ApplyInput(worker.interpreter, input);
+
+                                             try
+                                             {
+                                                 RunStep(worker.interpreter, settings, worker.covered_pcs);
+                                             }
+                                             catch (const std::exception& e)
+                                             {
+                                                 worker.faulted_states++;
+                                                 continue;
+                                             }
+
+                                             worker.child_state = worker.interpreter.SaveState();
+                                             uint64_t state_hash = HashMachineState(worker.child_state);
+
+                                             if (!visited_states.Insert(state_hash))
+                                             {
+                                                 worker.pruned_states++;
+                                                 continue;
+                                             }
+
+                                             EncodeStateDelta(root_state, worker.child_state, worker.state_delta);
+
+                                             // Copied so the node holds exactly the delta, not the buffer capacity
+                                             ExplorerNode child{{worker.state_delta.begin(), worker.state_delta.end()},
+                                                                node.inputs};
+                                             child.inputs.push_back(input);
+
+                                             unique_states++;
+                                             report(worker.child_state, state_hash, child.inputs);
+                                             worker.next_level.push_back(std::move(child));
+                                         }
+                                     }
+                                 });
+        }
+
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+
+        size_t level_states = 0;
+
+        for (auto& worker: workers)
+        {
+            level_states += worker->next_level.size();
+            std::move(worker->next_level.begin(), worker->next_level.end(), std::back_inserter(frontier));
+            worker->next_level.clear();
+        }
+
+        if (level_states == 0)
+        {
+            break;
+        }
+
+        stats.states_per_depth.push_back(level_states);
+        stats.max_depth_reached = depth + 1;
+
+        if (unique_states >= settings.max_states)
+        {
+            break;
+        }
+    }
+
+    std::bitset<C8_MEMORY_SIZE> covered_pcs;
+
+    for (auto& worker: workers)
+    {
+        covered_pcs |= worker->covered_pcs;
+        stats.expanded_states += worker->expanded_states;
+        stats.pruned_states += worker->pruned_states;
+        stats.faulted_states += worker->faulted_states;
+    }
+
+    stats.covered_instructions = covered_pcs.count();
+
+    for (auto& block: AnalyzeROM(rom).blocks)
+    {
+        stats.reachable_instructions += (block.end - block.start) / 2;
+    }
+
+    stats.unique_states = unique_states;
+    stats.unique_screens = unique_screens;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    return stats;
+}
+
+Chip8MachineState ReplayInputs(const std::vector<uint8_t>& rom, const Chip8ExplorerSettings& settings,
+                               const std::vector<uint8_t>& inputs)
+{
+    Chip8Interpreter interpreter;
+    PowerOn(interpreter, rom, settings.seed);
+    std::bitset<C8_MEMORY_SIZE> covered_pcs;
+
+    for (auto input: inputs)
+    {
+        ApplyInput(interpreter, input);
+        RunStep(interpreter, settings, covered_pcs);
+    }
+
+    return interpreter.SaveState();
+}
+
+std::string FormatExplorerInputs(const std::vector<uint8_t>& inputs)
+{
+    std::string text;
+
+    for (auto input: inputs)
+    {
+        text += input == EXPLORER_NO_KEY ? '.' : "0123456789ABCDEF"[input];
+    }
+
+    return text;
+}
+
+std::vector<uint8_t> ParseExplorerInputs(const std::string& text)
+{
+    std::vector<uint8_t> inputs;
+
+    for (auto character: text)
+    {
+        if (character == '.')
+        {
+            inputs.push_back(EXPLORER_NO_KEY);
+        }
+        else if (isxdigit(character))
+        {
+            inputs.push_back(std::stoi(std::string(1, character), nullptr, 16));
+        }
+        else
+        {
+            throw std::invalid_argument("Invalid input sequence: " + text);
+        }
+    }
+
+    return inputs;
+}
@@ -0,0 +1,66 @@
+#ifndef CALICOC8_EXPLORER_HH
+#define CALICOC8_EXPLORER_HH
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Interpreter.hh"
+
+// Input held during one exploration step, either nothing or a single key
+constexpr int EXPLORER_NO_KEY = 16;
+constexpr int EXPLORER_INPUT_COUNT = 17;
+
+struct Chip8ExplorerSettings
+{
+    uint32_t frames_per_input = 4;
+    uint32_t instructions_per_frame = 10;
+    uint32_t max_depth = 64;
+    size_t max_states = 100'000;
+    unsigned int threads = 1;
+    uint32_t seed = 1;
+};
+
+// Every state reached for the first time, replaying inputs from power on with the same settings reaches it again
+struct Chip8ExploredState
+{
+    uint64_t state_hash = 0;
+    uint64_t frame_buffer_hash = 0;
+    bool new_screen = false;
+    std::vector<uint8_t> inputs;
+};
+
+struct Chip8ExplorationStats
+{
+    size_t unique_states = 0;
+    size_t unique_screens = 0;
+    size_t expanded_states = 0;
+    size_t pruned_states = 0;
+    size_t faulted_states = 0;
+    uint32_t max_depth_reached = 0;
+    std::vector<size_t> states_per_depth;
+
+    // Instructions executed at least once, compared against what static analysis considers reachable
+    size_t covered_instructions = 0;
+    size_t reachable_instructions = 0;
+
+    double seconds = 0.0;
+};
+
+// Memory, registers, stack, timers and frame buffer, keypad and RNG state are deliberately left out
+uint64_t HashMachineState(const Chip8MachineState& state);
+uint64_t HashFrameBuffer(const Chip8FrameBuffer& frame_buffer);
+
+// Level synchronous breadth-first search over input sequences, states are deduplicated by hash.
+// Callback is invoked from worker threads, serialized by the explorer.
+Chip8ExplorationStats ExploreROM(const std::vector<uint8_t>& rom, const Chip8ExplorerSettings& settings,
+                                 const std::function<void(const Chip8ExploredState&)>& on_new_state);
+
+Chip8MachineState ReplayInputs(const std::vector<uint8_t>& rom, const Chip8ExplorerSettings& settings,
+                               const std::vector<uint8_t>& inputs);
+
+// One character per step, hex digit of the key or '.' when nothing is held
+std::string FormatExplorerInputs(const std::vector<uint8_t>& inputs);
+std::vector<uint8_t> ParseExplorerInputs(const std::string& text);
+
+#endif //CALICOC8_EXPLORER_HH
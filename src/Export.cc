@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <iomanip>
+#include <sstream>
+#include "Export.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Same beep as the SDL audio callback, 441 hz sine
+constexpr double EXPORT_TONE_FREQUENCY = 441.0;
+constexpr double EXPORT_TONE_AMPLITUDE = 28000.0;
+constexpr int EXPORT_SAMPLES_PER_FRAME = C8_EXPORT_SAMPLE_RATE / C8_EXPORT_FRAME_RATE;
+constexpr size_t EXPORT_WAV_HEADER_SIZE = 44;
+
+// Largest payload of an uncompressed deflate block
+constexpr size_t EXPORT_DEFLATE_STORED_BLOCK_SIZE = 65535;
+
+static void AppendBigEndian32(std::vector<uint8_t>& buffer, uint32_t value)
+{
+    buffer.push_back(value >> 24);
+    buffer.push_back(value >> 16);
+    buffer.push_back(value >> 8);
+    buffer.push_back(value);
+}
+
+static void AppendLittleEndian(std::vector<uint8_t>& buffer, uint32_t value, int bytes)
+{
+    for (auto i = 0; i < bytes; i++)
+    {
+        buffer.push_back(value >> (i * 8));
+    }
+}
+
+static uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t length)
+{
+    static const std::array<uint32_t, 256> table = []
+    {
+        std::array<uint32_t, 256> crc_table{};
+
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+
+            for (auto k = 0; k < 8; k++)
+            {
+                c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+
+            crc_table[n] = c;
+        }
+
+        return crc_table;
+    }();
+
+    crc = ~crc;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static void AppendPngChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+{
+    AppendBigEndian32(png, data.size());
+
+    size_t type_offset = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+
+    AppendBigEndian32(png, UpdateCrc32(0, png.data() + type_offset, png.size() - type_offset));
+}
+
+// 8 bit grayscale, image data is stored in uncompressed deflate blocks so no zlib is needed
+static void EncodePng(const std::vector<uint8_t>& image, int width, int height, std::vector<uint8_t>& png)
+{
+    static constexpr uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    png.assign(signature, signature + sizeof(signature));
+
+    std::vector<uint8_t> header;
+    AppendBigEndian32(header, width);
+    AppendBigEndian32(header, height);
+    header.insert(header.end(), {8, 0, 0, 0, 0});
+    AppendPngChunk(png, "IHDR", header);
+
+    // Every row starts with filter type 0 (none)
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve((width + 1) * height);
+
+    for (auto y = 0; y < height; y++)
+    {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), image.begin() + y * width, image.begin() + (y + 1) * width);
+    }
+
+    std::vector<uint8_t> zlib_stream = {0x78, 0x01};
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+
+    for (size_t offset = 0; offset < scanlines.size(); offset += EXPORT_DEFLATE_STORED_BLOCK_SIZE)
+    {
+        size_t length = std::min(EXPORT_DEFLATE_STORED_BLOCK_SIZE, scanlines.size() - offset);
+
+        zlib_stream.push_back(offset + length == scanlines.size() ? 1 : 0);
+        AppendLittleEndian(zlib_stream, length, 2);
+        AppendLittleEndian(zlib_stream, ~length & 0xFFFF, 2);
+        zlib_stream.insert(zlib_stream.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+
+        for (size_t i = offset; i < offset + length; i++)
+        {
+            adler_a = (adler_a + scanlines[i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+
+    AppendBigEndian32(zlib_stream, (adler_b << 16) | adler_a);
+    AppendPngChunk(png, "IDAT", zlib_stream);
+    AppendPngChunk(png, "IEND", {});
+}
+
+static std::string GetPngFramePath(const std::string& path, uint64_t frame)
+{
+    std::stringstream number;
+    number << std::setfill('0') << std::setw(6) << frame;
+
+    size_t extension = path.rfind('.');
+
+    return path.substr(0, extension) + "_" + number.str() + path.substr(extension);
+}
+
+// Luma of the C8_PALETTE colors
+static constexpr std::array<uint8_t, 4> C8_EXPORT_LUMA{0x00, 0xFF, 0x55, 0xAA};
+
+// 16 pixels of a packed row starting at pixel x, leftmost one in the top bit
+static uint16_t ExtractRowBits(const uint64_t* row, int x)
+{
+    uint64_t word = x < 64 ? (row[0] << x) | (x == 0 ? 0 : row[1] >> (64 - x)) : row[1] << (x - 64);
+
+    return static_cast<uint16_t>(word >> 48);
+}
+
+void ScaleFrameBitmap(const Chip8ExportFrame& frame, int scale, uint8_t* image)
+{
+    const Chip8FrameBuffer& frame_buffer = frame.frame_buffer;
+
+    // Output size doesn't depend on the mode, high resolution frames get half as large pixels
+    int width = CHIP8_RES_X * scale;
+    int height = CHIP8_RES_Y * scale;
+    int source_width = frame_buffer.GetWidth();
+    int source_height = frame_buffer.GetHeight();
+
+#ifdef __SSE2__
+    // Every 16 output pixels come from at most 16 consecutive source pixels as long as the image isn't shrunk,
+    // each 16 bit lane tests one of them and packing the lanes to bytes turns 0xFFFF into 0xFF
+    bool vectorized = source_width <= width;
+    int chunk_count = width / 16;
+    std::vector<int> chunk_starts(chunk_count);
+    std::vector<std::array<uint16_t, 16>> chunk_lane_bits(chunk_count);
+
+    for (auto chunk = 0; chunk < chunk_count && vectorized; chunk++)
+    {
+        chunk_starts[chunk] = chunk * 16 * source_width / width;
+
+        for (auto lane = 0; lane < 16; lane++)
+        {
+            chunk_lane_bits[chunk][lane] = 0x8000 >> ((chunk * 16 + lane) * source_width / width - chunk_starts[chunk]);
+        }
+    }
+#endif
+
+    int last_source_y = -1;
+
+    for (auto y = 0; y < height; y++)
+    {
+        uint8_t* line = image + static_cast<size_t>(y) * width;
+        int source_y = y * source_height / height;
+
+        if (source_y == last_source_y)
+        {
+            std::memcpy(line, line - width, width);
+            continue;
+        }
+
+        last_source_y = source_y;
+
+        const uint64_t* first_row = frame_buffer.GetPlaneRows(0) + source_y * C8_ROW_WORDS;
+        const uint64_t* second_row = frame_buffer.GetPlaneRows(1) + source_y * C8_ROW_WORDS;
+
+#ifdef __SSE2__
+        if (vectorized)
+        {
+            const __m128i second_only = _mm_set1_epi8(static_cast<char>(C8_EXPORT_LUMA[2]));
+            const __m128i both = _mm_set1_epi8(static_cast<char>(C8_EXPORT_LUMA[3]));
+
+            for (auto chunk = 0; chunk < chunk_count; chunk++)
+            {
+                __m128i low_mask = _mm_loadu_si128((const __m128i*) chunk_lane_bits[chunk].data());
+                __m128i high_mask = _mm_loadu_si128((const __m128i*) (chunk_lane_bits[chunk].data() + 8));
+
+                __m128i first_bits = _mm_set1_epi16(static_cast<int16_t>(ExtractRowBits(first_row, chunk_starts[chunk])));
+                __m128i first = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(first_bits, low_mask), low_mask),
+                                                _mm_cmpeq_epi16(_mm_and_si128(first_bits, high_mask), high_mask));
+
+                __m128i second_bits = _mm_set1_epi16(static_cast<int16_t>(ExtractRowBits(second_row, chunk_starts[chunk])));
+                __m128i second = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(second_bits, low_mask), low_mask),
+                                                 _mm_cmpeq_epi16(_mm_and_si128(second_bits, high_mask), high_mask));
+
+                // First plane alone is already 0xFF, the other two combinations are blended in
+                __m128i luma = _mm_or_si128(_mm_andnot_si128(second, first),
+                                            _mm_or_si128(_mm_and_si128(_mm_andnot_si128(first, second), second_only),
+                                                         _mm_and_si128(_mm_and_si128(first, second), both)));
+
+                _mm_storeu_si128((__m128i*) (line + chunk * 16), luma);
+            }
+
+            continue;
+        }
+#endif
+
+        for (auto x = 0; x < width; x++)
+        {
+            int source_x = x * source_width / width;
+            int shift = 63 - source_x % 64;
+
+            line[x] = C8_EXPORT_LUMA[((first_row[source_x / 64] >> shift) & 1) |
+                                     (((second_row[source_x / 64] >> shift) & 1) << 1)];
+        }
+    }
+}
+
+Chip8Exporter::Chip8Exporter(const Chip8ExportSettings& settings)
+        : _settings(settings)
+{
+    if (_settings.scale < 1)
+    {
+        throw std::invalid_argument("Export scale needs to be at least 1");
+    }
+
+    _width = CHIP8_RES_X * _settings.scale;
+    _height = CHIP8_RES_Y * _settings.scale;
+    _image.resize(static_cast<size_t>(_width) * _height);
+
+    const std::string& video_path = _settings.video_path;
+
+    if (video_path.size() > 4 && video_path.compare(video_path.size() - 4, 4, ".png") == 0)
+    {
+        _format = Chip8ExportFormat::PNG;
+    }
+    else if (video_path.size() > 4 && video_path.compare(video_path.size() - 4, 4, ".y4m") == 0)
+    {
+        _format = Chip8ExportFormat::Y4M;
+
+        _video_file.open(video_path, std::ios::binary);
+        if (!_video_file)
+        {
+            throw std::runtime_error("Unable to open export file " + video_path);
+        }
+
+        _video_file << "YUV4MPEG2 W" << _width << " H" << _height << " F" << C8_EXPORT_FRAME_RATE
+                    << ":1 Ip A1:1 C420jpeg\n";
+    }
+    else if (!video_path.empty())
+    {
+        throw std::invalid_argument("Export file needs to be .y4m or .png: " + video_path);
+    }
+
+    if (!_settings.audio_path.empty())
+    {
+        _audio_file.open(_settings.audio_path, std::ios::binary);
+        if (!_audio_file)
+        {
+            throw std::runtime_error("Unable to open export file " + _settings.audio_path);
+        }
+
+        // Sizes are filled in once the export is finished
+        _audio_file.write(std::string(EXPORT_WAV_HEADER_SIZE, '\0').data(), EXPORT_WAV_HEADER_SIZE);
+        _samples.resize(EXPORT_SAMPLES_PER_FRAME);
+    }
+
+    _encoder = std::thread(&Chip8Exporter::EncoderThread, this);
+}
+
+Chip8Exporter::~Chip8Exporter()
+{
+    try
+    {
+        Finish();
+    }
+    catch (const std::exception& e)
+    {
+    }
+}
+
+void Chip8Exporter::SubmitFrame(const Chip8FrameBuffer& frame_buffer, bool sound)
+{
+    Chip8ExportFrame frame{frame_buffer, sound};
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _space_available.wait(lock, [this] { return _queue.size() < C8_EXPORT_QUEUE_CAPACITY || !_error.empty(); });
+
+    if (!_error.empty())
+    {
+        throw std::runtime_error("Export failed: " + _error);
+    }
+
+    _queue.push_back(frame);
+    lock.unlock();
+
+    _frame_available.notify_one();
+}
+
+void Chip8Exporter::Finish()
+{
+    if (!_encoder.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finishing = true;
+    }
+
+    _frame_available.notify_one();
+    _encoder.join();
+
+    if (_audio_file.is_open())
+    {
+        FinishAudio();
+    }
+
+    _video_file.close();
+    _audio_file.close();
+
+    if (!_error.empty())
+    {
+        throw std::runtime_error("Export failed: " + _error);
+    }
+}
+
+uint64_t Chip8Exporter::GetWrittenFrameCount() const
+{
+    return _written_frames;
+}
+
+void Chip8Exporter::EncoderThread()
+{
+    while (true)
+    {
+        Chip8ExportFrame frame;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _frame_available.wait(lock, [this] { return !_queue.empty() || _finishing; });
+
+            if (_queue.empty())
+            {
+                return;
+            }
+
+            frame = _queue.front();
+            _queue.pop_front();
+        }
+
+        _space_available.notify_one();
+
+        try
+        {
+            EncodeFrame(frame);
+        }
+        catch (const std::exception& e)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _error = e.what();
+            _queue.clear();
+            _space_available.notify_all();
+
+            return;
+        }
+    }
+}
+
+void Chip8Exporter::EncodeFrame(const Chip8ExportFrame& frame)
+{
+    if (!_settings.video_path.empty())
+    {
+        ScaleFrameBitmap(frame, _settings.scale, _image.data());
+        WriteVideoFrame(_image);
+    }
+
+    if (_audio_file.is_open())
+    {
+        WriteAudioFrame(frame.sound);
+    }
+
+    _written_frames++;
+}
+
+void Chip8Exporter::WriteVideoFrame(const std::vector<uint8_t>& image)
+{
+    if (_format == Chip8ExportFormat::PNG)
+    {
+        EncodePng(image, _width, _height, _encoded);
+
+        std::string path = GetPngFramePath(_settings.video_path, _written_frames);
+        std::ofstream file(path, std::ios::binary);
+
+        if (!file.write((const char*) _encoded.data(), _encoded.size()))
+        {
+            throw std::runtime_error("Unable to write " + path);
+        }
+
+        return;
+    }
+
+    // Neutral chroma, picture is grayscale
+    if (_encoded.empty())
+    {
+        _encoded.assign(static_cast<size_t>(_width / 2) * (_height / 2) * 2, 0x80);
+    }
+
+    _video_file << "FRAME\n";
+    _video_file.write((const char*) image.data(), image.size());
+    _video_file.write((const char*) _encoded.data(), _encoded.size());
+
+    if (!_video_file)
+    {
+        throw std::runtime_error("Unable to write " + _settings.video_path);
+    }
+}
+
+void Chip8Exporter::WriteAudioFrame(bool sound)
+{
+    for (auto& sample: _samples)
+    {
+        double time = static_cast<double>(_audio_sample_number++) / C8_EXPORT_SAMPLE_RATE;
+        sample = sound ? static_cast<int16_t>(EXPORT_TONE_AMPLITUDE * sin(2.0 * M_PI * EXPORT_TONE_FREQUENCY * time))
+                       : 0;
+    }
+
+    _audio_file.write((const char*) _samples.data(), _samples.size() * sizeof(int16_t));
+    _audio_data_size += _samples.size() * sizeof(int16_t);
+
+    if (!_audio_file)
+    {
+        throw std::runtime_error("Unable to write " + _settings.audio_path);
+    }
+}
+
+// Canonical 16 bit mono PCM header, written over the placeholder at the start of the file
+void Chip8Exporter::FinishAudio()
+{
+    std::vector<uint8_t> header;
+
+    header.insert(header.end(), {'R', 'I', 'F', 'F'});
+    AppendLittleEndian(header, EXPORT_WAV_HEADER_SIZE - 8 + _audio_data_size, 4);
+    header.insert(header.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    AppendLittleEndian(header, 16, 4);
+    AppendLittleEndian(header, 1, 2);
+    AppendLittleEndian(header, 1, 2);
+    AppendLittleEndian(header, C8_EXPORT_SAMPLE_RATE, 4);
+    AppendLittleEndian(header, C8_EXPORT_SAMPLE_RATE * sizeof(int16_t), 4);
+    AppendLittleEndian(header, sizeof(int16_t), 2);
+    AppendLittleEndian(header, 16, 2);
+    header.insert(header.end(), {'d', 'a', 't', 'a'});
+    AppendLittleEndian(header, _audio_data_size, 4);
+
+    _audio_file.seekp(0);
+    _audio_file.write((const char*) header.data(), header.size());
+}
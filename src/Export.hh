@@ -0,0 +1,98 @@
+#ifndef CALICOC8_EXPORT_HH
+#define CALICOC8_EXPORT_HH
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameBuffer.hh"
+
+constexpr int C8_EXPORT_FRAME_RATE = 60;
+constexpr int C8_EXPORT_SAMPLE_RATE = 44100;
+constexpr size_t C8_EXPORT_QUEUE_CAPACITY = 120;
+
+enum class Chip8ExportFormat
+{
+    // Single raw 4:2:0 video file
+    Y4M,
+    // One grayscale image per frame, frame number is inserted before the extension
+    PNG
+};
+
+struct Chip8ExportSettings
+{
+    // Empty path disables that part of the export
+    std::string video_path;
+    std::string audio_path;
+    int scale = 10;
+};
+
+// Packed frame buffers are small enough to be copied into the queue as is
+struct Chip8ExportFrame
+{
+    Chip8FrameBuffer frame_buffer;
+    bool sound = false;
+};
+
+// Frames are copied on the emulation thread, scaling, encoding and writing happen on a background
+// thread. Once the bounded queue fills up SubmitFrame blocks until the encoder catches up.
+class Chip8Exporter
+{
+public:
+    explicit Chip8Exporter(const Chip8ExportSettings& settings);
+    ~Chip8Exporter();
+
+    Chip8Exporter(const Chip8Exporter&) = delete;
+    Chip8Exporter& operator=(const Chip8Exporter&) = delete;
+
+    // Throws when the encoder failed, ex. on a full disk
+    void SubmitFrame(const Chip8FrameBuffer& frame_buffer, bool sound);
+
+    // Flushes remaining frames and finalizes files, throws when the encoder failed
+    void Finish();
+
+    uint64_t GetWrittenFrameCount() const;
+
+private:
+    void EncoderThread();
+    void EncodeFrame(const Chip8ExportFrame& frame);
+    void WriteVideoFrame(const std::vector<uint8_t>& image);
+    void WriteAudioFrame(bool sound);
+    void FinishAudio();
+
+    Chip8ExportSettings _settings;
+    Chip8ExportFormat _format = Chip8ExportFormat::Y4M;
+    int _width = 0;
+    int _height = 0;
+
+    std::mutex _mutex;
+    std::condition_variable _frame_available;
+    std::condition_variable _space_available;
+    std::deque<Chip8ExportFrame> _queue;
+    bool _finishing = false;
+    std::string _error;
+    std::thread _encoder;
+
+    // Encoder thread only
+    std::ofstream _video_file;
+    std::ofstream _audio_file;
+    std::vector<uint8_t> _image;
+    std::vector<uint8_t> _encoded;
+    std::vector<int16_t> _samples;
+    uint64_t _audio_sample_number = 0;
+    uint32_t _audio_data_size = 0;
+
+    std::atomic<uint64_t> _written_frames{0};
+};
+
+// Expands packed rows to 8 bit luma, frames are scaled to CHIP8_RES_X * scale by CHIP8_RES_Y * scale in both
+// resolutions
+void ScaleFrameBitmap(const Chip8ExportFrame& frame, int scale, uint8_t* image);
+
+#endif //CALICOC8_EXPORT_HH
@@ -1,30 +1,242 @@
 #include "FrameBuffer.hh"
 
-Pixel Chip8FrameBuffer::GetPixelFrom2DCords(int x, int y) const
+int Chip8FrameBuffer::GetWidth() const
+{
+    return _high_resolution ? C8_HIRES_RES_X : CHIP8_RES_X;
+}
+
+int Chip8FrameBuffer::GetHeight() const
+{
+    return _high_resolution ? C8_HIRES_RES_Y : CHIP8_RES_Y;
+}
+
+bool Chip8FrameBuffer::IsHighResolution() const
+{
+    return _high_resolution;
+}
+
+void Chip8FrameBuffer::SetHighResolution(bool high_resolution)
 {
-    uint32_t index = CalculateArrayIndexFrom2DCoordinates(x, y, CHIP8_RES_X, CHIP8_RES_Y) * sizeof(uint32_t);
+    _high_resolution = high_resolution;
+    Clear();
+}
 
-    return _raw_framebuffer[index];
+uint64_t* Chip8FrameBuffer::GetRow(int plane, int y)
+{
+    return &_rows[(plane * C8_HIRES_RES_Y + y) * C8_ROW_WORDS];
 }
 
-uint32_t* Chip8FrameBuffer::GetSDLPixelArray()
+const uint64_t* Chip8FrameBuffer::GetPlaneRows(int plane) const
 {
-    return (uint32_t*) _raw_framebuffer.data();
+    return &_rows[plane * C8_HIRES_RES_Y * C8_ROW_WORDS];
 }
 
-void Chip8FrameBuffer::FlipPixel(int x, int y)
+uint8_t Chip8FrameBuffer::GetPixelColor(int x, int y) const
 {
-    uint32_t index = CalculateArrayIndexFrom2DCoordinates(x, y, CHIP8_RES_X, CHIP8_RES_Y) * sizeof(uint32_t);
+    uint32_t index = CalculateArrayIndexFrom2DCoordinates(x, y, GetWidth(), GetHeight());
+    int row = index / GetWidth();
+    int column = index % GetWidth();
 
-    bool original_pixel_status = _raw_framebuffer[index] == 0xFF;
+    uint8_t color = 0;
 
-    _raw_framebuffer.at(index) = original_pixel_status ? 0x00 : 0xFF;
-    _raw_framebuffer.at(index + 1) = original_pixel_status ? 0x00 : 0xFF;
-    _raw_framebuffer.at(index + 2) = original_pixel_status ? 0x00 : 0xFF;
-    _raw_framebuffer.at(index + 3) = original_pixel_status ? 0x00 : 0xFF;
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        uint64_t word = GetPlaneRows(plane)[row * C8_ROW_WORDS + column / 64];
+        color |= ((word >> (63 - column % 64)) & 1) << plane;
+    }
+
+    return color;
+}
+
+Pixel Chip8FrameBuffer::GetPixelFrom2DCords(int x, int y) const
+{
+    return GetPixelColor(x, y) != 0;
+}
+
+bool Chip8FrameBuffer::DrawSpriteRow(int x, int y, uint16_t bits, int sprite_width, int plane, bool wrap)
+{
+    x %= GetWidth();
+
+    if (wrap)
+    {
+        y %= GetHeight();
+    }
+    else if (y >= GetHeight())
+    {
+        return false;
+    }
+
+    uint64_t* row = GetRow(plane, y);
+    uint64_t sprite = static_cast<uint64_t>(bits) << (64 - sprite_width);
+
+    if (!_high_resolution)
+    {
+        uint64_t mask = x == 0 ? sprite : wrap ? (sprite >> x) | (sprite << (64 - x)) : sprite >> x;
+        bool collision = (row[0] & mask) != 0;
+
+        row[0] ^= mask;
+
+        return collision;
+    }
+
+    // Same as above over a 128 bit row
+    uint64_t high = sprite;
+    uint64_t low = 0;
+
+    if (x >= 64)
+    {
+        low = high;
+        high = 0;
+        x -= 64;
+    }
+
+    if (x != 0)
+    {
+        // Pixels pushed past the right edge come back on the left when wrapping
+        uint64_t wrapped = low << (64 - x);
+
+        low = (low >> x) | (high << (64 - x));
+        high = (high >> x) | (wrap ? wrapped : 0);
+    }
+
+    bool collision = (row[0] & high) != 0 || (row[1] & low) != 0;
+
+    row[0] ^= high;
+    row[1] ^= low;
+
+    return collision;
 }
 
 void Chip8FrameBuffer::Clear()
 {
-    memset(_raw_framebuffer.data(), 0, CHIP8_RES_Y * CHIP8_RES_X * sizeof(uint32_t));
+    _rows.fill(0);
+}
+
+void Chip8FrameBuffer::Clear(uint8_t plane_mask)
+{
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        if ((plane_mask & (1 << plane)) != 0)
+        {
+            memset(GetRow(plane, 0), 0, C8_HIRES_RES_Y * C8_ROW_WORDS * sizeof(uint64_t));
+        }
+    }
+}
+
+void Chip8FrameBuffer::ScrollDown(int rows, uint8_t plane_mask)
+{
+    rows = rows < GetHeight() ? rows : GetHeight();
+
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        if ((plane_mask & (1 << plane)) != 0)
+        {
+            memmove(GetRow(plane, rows), GetRow(plane, 0), (GetHeight() - rows) * C8_ROW_WORDS * sizeof(uint64_t));
+            memset(GetRow(plane, 0), 0, rows * C8_ROW_WORDS * sizeof(uint64_t));
+        }
+    }
+}
+
+void Chip8FrameBuffer::ScrollUp(int rows, uint8_t plane_mask)
+{
+    rows = rows < GetHeight() ? rows : GetHeight();
+
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        if ((plane_mask & (1 << plane)) != 0)
+        {
+            memmove(GetRow(plane, 0), GetRow(plane, rows), (GetHeight() - rows) * C8_ROW_WORDS * sizeof(uint64_t));
+            memset(GetRow(plane, GetHeight() - rows), 0, rows * C8_ROW_WORDS * sizeof(uint64_t));
+        }
+    }
+}
+
+void Chip8FrameBuffer::ScrollRight(int pixels, uint8_t plane_mask)
+{
+    if (pixels <= 0 || pixels >= 64)
+    {
+        return;
+    }
+
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        if ((plane_mask & (1 << plane)) == 0)
+        {
+            continue;
+        }
+
+        for (auto y = 0; y < GetHeight(); y++)
+        {
+            uint64_t* row = GetRow(plane, y);
+
+            if (_high_resolution)
+            {
+                row[1] = (row[1] >> pixels) | (row[0] << (64 - pixels));
+            }
+
+            row[0] >>= pixels;
+        }
+    }
+}
+
+void Chip8FrameBuffer::ScrollLeft(int pixels, uint8_t plane_mask)
+{
+    if (pixels <= 0 || pixels >= 64)
+    {
+        return;
+    }
+
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        if ((plane_mask & (1 << plane)) == 0)
+        {
+            continue;
+        }
+
+        for (auto y = 0; y < GetHeight(); y++)
+        {
+            uint64_t* row = GetRow(plane, y);
+
+            if (_high_resolution)
+            {
+                row[0] = (row[0] << pixels) | (row[1] >> (64 - pixels));
+                row[1] <<= pixels;
+            }
+            else
+            {
+                row[0] <<= pixels;
+            }
+        }
+    }
+}
+
+void Chip8FrameBuffer::RenderRGBA(uint32_t* pixels, int pitch) const
+{
+    const uint64_t* first_plane = GetPlaneRows(0);
+    const uint64_t* second_plane = GetPlaneRows(1);
+
+    pitch = pitch != 0 ? pitch : GetWidth();
+
+    for (auto y = 0; y < GetHeight(); y++)
+    {
+        uint32_t* line = pixels + static_cast<size_t>(y) * pitch;
+
+        for (auto x = 0; x < GetWidth(); x++)
+        {
+            int word = y * C8_ROW_WORDS + x / 64;
+            int shift = 63 - x % 64;
+
+            line[x] = C8_PALETTE[((first_plane[word] >> shift) & 1) | (((second_plane[word] >> shift) & 1) << 1)];
+        }
+    }
+}
+
+const uint8_t* Chip8FrameBuffer::GetPackedData() const
+{
+    return reinterpret_cast<const uint8_t*>(_rows.data());
+}
+
+bool Chip8FrameBuffer::operator==(const Chip8FrameBuffer& other) const
+{
+    return _high_resolution == other._high_resolution && _rows == other._rows;
 }
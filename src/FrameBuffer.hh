@@ -10,22 +10,73 @@ typedef bool Pixel;
 constexpr int CHIP8_RES_X = 64;
 constexpr int CHIP8_RES_Y = 32;
 
+// SUPER-CHIP/XO-CHIP high resolution mode
+constexpr int C8_HIRES_RES_X = 128;
+constexpr int C8_HIRES_RES_Y = 64;
+
+// XO-CHIP bitplanes, classic programs only ever draw to the first one
+constexpr int C8_PLANE_COUNT = 2;
+constexpr int C8_ROW_WORDS = C8_HIRES_RES_X / 64;
+
+// Colors by plane bits (plane 1 is bit 0), ABGR8888 like the SDL texture
+constexpr std::array<uint32_t, 4> C8_PALETTE{0x00000000, 0xFFFFFFFF, 0xFF555555, 0xFFAAAAAA};
+
 constexpr int CalculateArrayIndexFrom2DCoordinates(int x, int y, int w, int h)
 {
     return (y % h) * w + (x % w);
 }
 
+// Bit packed planes, bit 63 of the first word of a row is its leftmost pixel. Low resolution rows only use the
+// first word, so classic programs draw and scroll with single 64 bit operations.
 class Chip8FrameBuffer
 {
 public:
+    int GetWidth() const;
+    int GetHeight() const;
+    bool IsHighResolution() const;
+
+    // Switching resolution clears the screen
+    void SetHighResolution(bool high_resolution);
+
+    // Lit in any plane, coordinates wrap around
     Pixel GetPixelFrom2DCords(int x, int y) const;
-    void FlipPixel(int x, int y);
+    uint8_t GetPixelColor(int x, int y) const;
+
+    // XORs up to 16 pixels (bits, MSB is leftmost) into a plane, either wrapping around the edges or clipping
+    // at them. Returns true when a lit pixel was turned off.
+    bool DrawSpriteRow(int x, int y, uint16_t bits, int sprite_width, int plane, bool wrap);
+
     void Clear();
+    void Clear(uint8_t plane_mask);
+
+    // Pixels scrolled out are lost, new ones are dark
+    void ScrollDown(int rows, uint8_t plane_mask);
+    void ScrollUp(int rows, uint8_t plane_mask);
+    void ScrollRight(int pixels, uint8_t plane_mask);
+    void ScrollLeft(int pixels, uint8_t plane_mask);
+
+    // GetWidth() x GetHeight() pixels colored by C8_PALETTE, rows are pitch pixels apart (GetWidth() when 0)
+    void RenderRGBA(uint32_t* pixels, int pitch = 0) const;
 
-    uint32_t* GetSDLPixelArray();
+    // Packed planes as they are stored, for hashing and copying
+    const uint8_t* GetPackedData() const;
+    static constexpr size_t GetPackedSize()
+    {
+        return C8_PLANE_COUNT * C8_HIRES_RES_Y * C8_ROW_WORDS * sizeof(uint64_t);
+    }
+
+    // Row words of a plane, C8_ROW_WORDS per row
+    const uint64_t* GetPlaneRows(int plane) const;
+
+    bool operator==(const Chip8FrameBuffer& other) const;
 
 private:
-    std::array<uint8_t, 64 * 32 * sizeof(uint32_t)> _raw_framebuffer{0};
+    uint64_t* GetRow(int plane, int y);
+
+    std::array<uint64_t, C8_PLANE_COUNT * C8_HIRES_RES_Y * C8_ROW_WORDS> _rows{0};
+    bool _high_resolution = false;
+    // Explicit padding, frame buffers are part of machine states compared and hashed as raw bytes
+    uint8_t _reserved[7]{0};
 };
 
 #endif //CALICOC8_FRAMEBUFFER_HH
@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include "Emulator.hh"
+#include "GridViewer.hh"
+#include "RomFile.hh"
+
+// ABGR8888 as stored in the atlas
+constexpr uint32_t GRID_STATUS_COLOR = 0xFF303030;
+constexpr uint32_t GRID_STATUS_SOUND_COLOR = 0xFF603000;
+constexpr uint32_t GRID_STATUS_FAILED_COLOR = 0xFF000090;
+constexpr uint32_t GRID_TEXT_COLOR = 0xFFFFFFFF;
+constexpr uint32_t GRID_FOCUSED_TEXT_COLOR = 0xFF00FFFF;
+
+GridViewer::GridViewer(const ApplicationCmdSettings& args)
+        : _args(args)
+{
+}
+
+GridViewer::~GridViewer()
+{
+    StopWorkers();
+}
+
+int GridViewer::InitSDL()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+    {
+        _sdl_error_message = SDL_GetError();
+        return -1;
+    }
+
+    _window = SDL_CreateWindow("CalicoC8 grid", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                               _args.window_size_x, _args.window_size_y,
+                               SDL_WINDOW_SHOWN | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE);
+    if (_window == nullptr)
+    {
+        _sdl_error_message = "Unable to create SDL Window";
+        return -2;
+    }
+
+    _renderer = SDL_CreateRenderer(_window, 0, SDL_RENDERER_ACCELERATED);
+    if (_renderer == nullptr)
+    {
+        _sdl_error_message = "Unable to create SDL Renderer";
+        return -3;
+    }
+
+    // Atlas coordinates are used for drawing and mouse events, SDL scales them to the window
+    int atlas_width = _columns * C8_GRID_TILE_WIDTH;
+    int atlas_height = _rows * (C8_GRID_TILE_HEIGHT + C8_GRID_STATUS_HEIGHT);
+
+    SDL_RenderSetLogicalSize(_renderer, atlas_width, atlas_height);
+
+    _atlas_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
+                                       atlas_width, atlas_height);
+    if (_atlas_texture == nullptr)
+    {
+        _sdl_error_message = "Unable to create SDL Texture for the grid";
+        return -4;
+    }
+
+    return 0;
+}
+
+void GridViewer::CleanupSDL()
+{
+    SDL_DestroyTexture(_atlas_texture);
+    SDL_DestroyRenderer(_renderer);
+    SDL_DestroyWindow(_window);
+    SDL_Quit();
+}
+
+void GridViewer::StopWorkers()
+{
+    _workers_running = false;
+
+    for (auto& worker: _workers)
+    {
+        worker.join();
+    }
+
+    _workers.clear();
+}
+
+int GridViewer::Run(const std::vector<std::string>& rom_paths)
+{
+    try
+    {
+        for (auto& rom_path: rom_paths)
+        {
+            auto instance = std::make_unique<GridInstance>();
+            instance->rom_path = rom_path;
+            instance->interpreter = std::make_unique<Chip8Interpreter>(_args.variant);
+
+            Chip8RomMapping rom(rom_path);
+            instance->interpreter->LoadROM(rom.GetData(), rom.GetSize());
+
+            _instances.push_back(std::move(instance));
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return -1;
+    }
+
+    _columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(_instances.size()))));
+    _rows = (static_cast<int>(_instances.size()) + _columns - 1) / _columns;
+
+    int atlas_width = _columns * C8_GRID_TILE_WIDTH;
+    _atlas_pixels.assign(static_cast<size_t>(atlas_width) * _rows * (C8_GRID_TILE_HEIGHT + C8_GRID_STATUS_HEIGHT), 0);
+    _tile_widths.assign(_instances.size(), CHIP8_RES_X);
+    _tile_heights.assign(_instances.size(), CHIP8_RES_Y);
+
+    int init_sdl_res = InitSDL();
+    if (init_sdl_res != 0)
+    {
+        CleanupSDL();
+
+        std::cout << "Error: " << _sdl_error_message << std::endl;
+
+        return init_sdl_res;
+    }
+
+    size_t worker_count = std::min<size_t>(_instances.size(), std::max(1u, std::thread::hardware_concurrency()));
+    _workers_running = true;
+
+    for (size_t worker = 0; worker < worker_count; worker++)
+    {
+        _workers.emplace_back(&GridViewer::WorkerThread, this, worker, worker_count);
+    }
+
+    Focus(0);
+
+    bool main_loop_running = true;
+
+    while (main_loop_running)
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+
+        while (SDL_PollEvent(&_event) != 0)
+        {
+            if (_event.type == SDL_QUIT)
+            {
+                main_loop_running = false;
+            }
+            else
+            {
+                HandleEvent(_event);
+            }
+        }
+
+        UpdateAtlas();
+        SDL_UpdateTexture(_atlas_texture, nullptr, _atlas_pixels.data(), atlas_width * sizeof(uint32_t));
+
+        SDL_SetRenderDrawColor(_renderer, 0, 0, 0, 255);
+        SDL_RenderClear(_renderer);
+
+        for (size_t index = 0; index < _instances.size(); index++)
+        {
+            SDL_Rect tile = GetTileRect(index);
+            SDL_Rect frame{tile.x, tile.y, _tile_widths[index], _tile_heights[index]};
+            SDL_Rect status{tile.x, tile.y + tile.h, tile.w, C8_GRID_STATUS_HEIGHT};
+
+            SDL_RenderCopy(_renderer, _atlas_texture, &frame, &tile);
+            SDL_RenderCopy(_renderer, _atlas_texture, &status, &status);
+        }
+
+        SDL_Rect focused = GetTileRect(_focused);
+        focused.h += C8_GRID_STATUS_HEIGHT;
+
+        SDL_SetRenderDrawColor(_renderer, 255, 255, 0, 255);
+        SDL_RenderDrawRect(_renderer, &focused);
+        SDL_RenderPresent(_renderer);
+
+        uint64_t end = SDL_GetPerformanceCounter();
+
+        float elapsedMS = (float) (end - start) / (float) SDL_GetPerformanceFrequency() * 1000.0f;
+
+        // FPS cap set to 60
+        SDL_Delay(std::max(0.0f, std::floor(16.666f - elapsedMS)));
+    }
+
+    StopWorkers();
+    CleanupSDL();
+
+    return 0;
+}
+
+void GridViewer::WorkerThread(size_t first_instance, size_t stride)
+{
+    auto next_frame = std::chrono::steady_clock::now();
+
+    while (_workers_running)
+    {
+        for (size_t index = first_instance; index < _instances.size(); index += stride)
+        {
+            EmulateFrame(*_instances[index]);
+        }
+
+        // A worker falling behind drops frames instead of running them in a burst to catch up
+        next_frame += std::chrono::microseconds(16667);
+        next_frame = std::max(next_frame, std::chrono::steady_clock::now());
+
+        std::this_thread::sleep_until(next_frame);
+    }
+}
+
+void GridViewer::EmulateFrame(GridInstance& instance)
+{
+    std::vector<std::pair<CalicoEvent, CalicoKey>> keys;
+
+    {
+        std::lock_guard<std::mutex> lock(instance.mutex);
+
+        if (instance.failed)
+        {
+            return;
+        }
+
+        keys.swap(instance.pending_keys);
+    }
+
+    Chip8Interpreter& interpreter = *instance.interpreter;
+
+    for (auto& [event, key]: keys)
+    {
+        interpreter.HandleKeyEvent(event, key);
+    }
+
+    try
+    {
+        for (auto i = 0; i < _args.clock_speed / 60; i++)
+        {
+            interpreter.ExecuteNextInstruction();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << instance.rom_path << ": " << e.what() << std::endl;
+
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        instance.failed = true;
+
+        return;
+    }
+
+    interpreter.TickSoundTimer();
+    interpreter.TickDelayTimer();
+
+    std::lock_guard<std::mutex> lock(instance.mutex);
+
+    if (interpreter.DrawFlag())
+    {
+        instance.frame_buffer = interpreter.AccessFrameBuffer();
+        instance.frame_changed = true;
+
+        interpreter.DrawFlag(false);
+    }
+
+    instance.frames++;
+    instance.pc = interpreter.GetProgramCounter();
+    instance.sound = interpreter.ShouldPlaySound();
+}
+
+void GridViewer::HandleEvent(const SDL_Event& event)
+{
+    if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT)
+    {
+        int column = event.button.x / C8_GRID_TILE_WIDTH;
+        int row = event.button.y / (C8_GRID_TILE_HEIGHT + C8_GRID_STATUS_HEIGHT);
+        size_t index = static_cast<size_t>(row) * _columns + column;
+
+        if (event.button.x >= 0 && event.button.y >= 0 && column < _columns && index < _instances.size())
+        {
+            Focus(index);
+        }
+    }
+    else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+    {
+        QueueKeyEvent(_focused, TranslateSDLEventToCalicoEvent(event.type),
+                      TranslateSDLKeyToCalicoKey(event.key.keysym.sym, _args.keymap));
+    }
+}
+
+void GridViewer::Focus(size_t index)
+{
+    // Keys held while switching would otherwise stay pressed in the previous instance
+    if (index != _focused)
+    {
+        for (auto key = 0; key < 16; key++)
+        {
+            QueueKeyEvent(_focused, CalicoEvent::KeyUp, static_cast<CalicoKey>(key));
+        }
+    }
+
+    _focused = index;
+
+    SDL_SetWindowTitle(_window, ("CalicoC8 grid - " + _instances[index]->rom_path).c_str());
+}
+
+void GridViewer::QueueKeyEvent(size_t index, CalicoEvent event, CalicoKey key)
+{
+    if (event == CalicoEvent::Invalid || key == CalicoKey::Invalid)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_instances[index]->mutex);
+    _instances[index]->pending_keys.emplace_back(event, key);
+}
+
+void GridViewer::UpdateAtlas()
+{
+    int atlas_width = _columns * C8_GRID_TILE_WIDTH;
+
+    for (size_t index = 0; index < _instances.size(); index++)
+    {
+        auto& instance = *_instances[index];
+
+        // Copied out so rendering doesn't hold up the worker
+        Chip8FrameBuffer frame_buffer;
+        bool frame_changed;
+        uint64_t frames;
+        uint16_t pc;
+        bool sound;
+        bool failed;
+
+        {
+            std::lock_guard<std::mutex> lock(instance.mutex);
+
+            frame_changed = instance.frame_changed;
+            if (frame_changed)
+            {
+                frame_buffer = instance.frame_buffer;
+                instance.frame_changed = false;
+            }
+
+            frames = instance.frames;
+            pc = instance.pc;
+            sound = instance.sound;
+            failed = instance.failed;
+        }
+
+        if (frame_changed)
+        {
+            SDL_Rect tile = GetTileRect(index);
+
+            frame_buffer.RenderRGBA(&_atlas_pixels[static_cast<size_t>(tile.y) * atlas_width + tile.x], atlas_width);
+            _tile_widths[index] = frame_buffer.GetWidth();
+            _tile_heights[index] = frame_buffer.GetHeight();
+        }
+
+        DrawStatus(index, frames, pc, sound, failed);
+    }
+}
+
+void GridViewer::DrawStatus(size_t index, uint64_t frames, uint16_t pc, bool sound, bool failed)
+{
+    int atlas_width = _columns * C8_GRID_TILE_WIDTH;
+    SDL_Rect tile = GetTileRect(index);
+    int status_y = tile.y + tile.h;
+
+    uint32_t background = failed ? GRID_STATUS_FAILED_COLOR : sound ? GRID_STATUS_SOUND_COLOR : GRID_STATUS_COLOR;
+
+    for (auto y = 0; y < C8_GRID_STATUS_HEIGHT; y++)
+    {
+        std::fill_n(&_atlas_pixels[static_cast<size_t>(status_y + y) * atlas_width + tile.x], tile.w, background);
+    }
+
+    uint32_t text = index == _focused ? GRID_FOCUSED_TEXT_COLOR : GRID_TEXT_COLOR;
+
+    DrawHexDigits(tile.x + 2, status_y + 1, index, 2, text);
+    DrawHexDigits(tile.x + 16, status_y + 1, pc, 3, text);
+    DrawHexDigits(tile.x + 35, status_y + 1, frames, 6, text);
+}
+
+// 4x5 glyphs from the CHIP-8 fontset, 5 pixels apart
+void GridViewer::DrawHexDigits(int x, int y, uint64_t value, int digits, uint32_t color)
+{
+    int atlas_width = _columns * C8_GRID_TILE_WIDTH;
+
+    for (auto digit = 0; digit < digits; digit++)
+    {
+        int glyph = (value >> ((digits - 1 - digit) * 4)) & 0xF;
+
+        for (auto row = 0; row < 5; row++)
+        {
+            uint8_t bits = C8_FONTSET[glyph * 5 + row];
+
+            for (auto column = 0; column < 4; column++)
+            {
+                if ((bits & (0x80 >> column)) != 0)
+                {
+                    _atlas_pixels[static_cast<size_t>(y + row) * atlas_width + x + digit * 5 + column] = color;
+                }
+            }
+        }
+    }
+}
+
+// Frame area of the tile on screen and in the atlas, the status strip is right below it
+SDL_Rect GridViewer::GetTileRect(size_t index) const
+{
+    int column = static_cast<int>(index % _columns);
+    int row = static_cast<int>(index / _columns);
+
+    return {column * C8_GRID_TILE_WIDTH, row * (C8_GRID_TILE_HEIGHT + C8_GRID_STATUS_HEIGHT),
+            C8_GRID_TILE_WIDTH, C8_GRID_TILE_HEIGHT};
+}
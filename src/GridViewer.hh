@@ -0,0 +1,92 @@
+#ifndef CALICOC8_GRIDVIEWER_HH
+#define CALICOC8_GRIDVIEWER_HH
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CommandLine.hh"
+#include "Interpreter.hh"
+
+// Every tile is large enough for high resolution frames, low resolution ones are scaled up when drawn
+constexpr int C8_GRID_TILE_WIDTH = C8_HIRES_RES_X;
+constexpr int C8_GRID_TILE_HEIGHT = C8_HIRES_RES_Y;
+// Status strip under each tile, index, PC and frame count drawn with the CHIP-8 font
+constexpr int C8_GRID_STATUS_HEIGHT = 8;
+
+// Interpreter is only touched by its worker, everything below the mutex is shared with the main thread
+struct GridInstance
+{
+    std::string rom_path;
+    std::unique_ptr<Chip8Interpreter> interpreter;
+
+    std::mutex mutex;
+    Chip8FrameBuffer frame_buffer;
+    bool frame_changed = true;
+    std::vector<std::pair<CalicoEvent, CalicoKey>> pending_keys;
+    uint64_t frames = 0;
+    uint16_t pc = 0x200;
+    bool sound = false;
+    bool failed = false;
+};
+
+// Runs every ROM on a pool of worker threads and shows all of them in one window. Frames are gathered into a
+// single atlas texture, uploaded and presented once per refresh. Clicking a tile sends the keyboard to it.
+class GridViewer
+{
+public:
+    explicit GridViewer(const ApplicationCmdSettings& args);
+    ~GridViewer();
+
+    GridViewer(const GridViewer&) = delete;
+    GridViewer& operator=(const GridViewer&) = delete;
+
+    int Run(const std::vector<std::string>& rom_paths);
+
+private:
+    int InitSDL();
+    void CleanupSDL();
+    void StopWorkers();
+
+    // Worker n runs instances n, n + stride, n + 2 * stride...
+    void WorkerThread(size_t first_instance, size_t stride);
+    void EmulateFrame(GridInstance& instance);
+
+    void HandleEvent(const SDL_Event& event);
+    void Focus(size_t index);
+    void QueueKeyEvent(size_t index, CalicoEvent event, CalicoKey key);
+
+    // Copies changed frames and the status of every instance into the atlas
+    void UpdateAtlas();
+    void DrawStatus(size_t index, uint64_t frames, uint16_t pc, bool sound, bool failed);
+    void DrawHexDigits(int x, int y, uint64_t value, int digits, uint32_t color);
+
+    SDL_Rect GetTileRect(size_t index) const;
+
+    ApplicationCmdSettings _args;
+
+    std::vector<std::unique_ptr<GridInstance>> _instances;
+    std::vector<std::thread> _workers;
+    std::atomic<bool> _workers_running{false};
+
+    size_t _focused = 0;
+    int _columns = 1;
+    int _rows = 1;
+
+    // Layout of the atlas matches the layout on screen, a tile with its status strip below it per cell
+    std::vector<uint32_t> _atlas_pixels;
+    std::vector<int> _tile_widths;
+    std::vector<int> _tile_heights;
+
+    SDL_Window* _window = nullptr;
+    SDL_Renderer* _renderer = nullptr;
+    SDL_Texture* _atlas_texture = nullptr;
+    SDL_Event _event{};
+    std::string _sdl_error_message;
+};
+
+#endif //CALICOC8_GRIDVIEWER_HH
@@ -1,32 +1,188 @@
 #include <exception>
+#include <stdexcept>
 #include <string>
 #include <ctime>
+#include <algorithm>
+#include <cstdlib>
 #include "Interpreter.hh"
 
-Chip8Interpreter::Chip8Interpreter()
+Chip8Variant ParseChip8Variant(const std::string& name)
 {
+    if (name == "chip8")
+    {
+        return Chip8Variant::Chip8;
+    }
+
+    if (name == "schip")
+    {
+        return Chip8Variant::SuperChip;
+    }
+
+    if (name == "xochip")
+    {
+        return Chip8Variant::XOChip;
+    }
+
+    throw std::invalid_argument("Unknown variant: " + name);
+}
+
+std::string FormatChip8Variant(Chip8Variant variant)
+{
+    switch (variant)
+    {
+        case Chip8Variant::SuperChip:
+            return "schip";
+
+        case Chip8Variant::XOChip:
+            return "xochip";
+
+        default:
+            return "chip8";
+    }
+}
+
+Chip8Interpreter::Chip8Interpreter(Chip8Variant variant)
+        : _variant(variant)
+{
+    SeedRandom(static_cast<uint32_t>(time(nullptr)));
+
     for (auto i = 0; i < C8_FONTSET.size(); i++)
     {
-        _memory[i + 0x050] = C8_FONTSET[i];
+        _state.memory[i + C8_FONT_ADDRESS] = C8_FONTSET[i];
+    }
+
+    if (_variant != Chip8Variant::Chip8)
+    {
+        std::copy(C8_BIG_FONTSET.begin(), C8_BIG_FONTSET.end(), _state.memory.begin() + C8_BIG_FONT_ADDRESS);
+    }
+
+    if (_variant == Chip8Variant::XOChip)
+    {
+        _xo_memory.assign(C8_XO_MEMORY_SIZE, 0);
+        std::copy(_state.memory.begin(), _state.memory.end(), _xo_memory.begin());
+
+        _memory = _xo_memory.data();
+        _memory_mask = C8_XO_MEMORY_SIZE - 1;
     }
 }
 
-void Chip8Interpreter::LoadROM(const std::vector<uint8_t>& binary)
+Chip8Variant Chip8Interpreter::GetVariant() const
+{
+    return _variant;
+}
+
+void Chip8Interpreter::SeedRandom(uint32_t seed)
 {
-    if (binary.size() > C8_MEMORY_SIZE - 0x200 || binary.empty())
+    // Xorshift gets stuck on zero
+    _state.random_state = seed != 0 ? seed : 0x2545F491;
+}
+
+uint16_t Chip8Interpreter::GetProgramCounter() const
+{
+    return _state.pc;
+}
+
+uint16_t Chip8Interpreter::GetIndexRegister() const
+{
+    return _state.i;
+}
+
+uint8_t Chip8Interpreter::GetDelayTimer() const
+{
+    return _state.delay;
+}
+
+uint8_t Chip8Interpreter::GetSoundTimer() const
+{
+    return _state.sound;
+}
+
+uint8_t Chip8Interpreter::GetGeneralRegister(int index) const
+{
+    return _state.general[index];
+}
+
+size_t Chip8Interpreter::GetStackDepth() const
+{
+    return _state.stack_pointer;
+}
+
+uint8_t Chip8Interpreter::GetSelectedPlanes() const
+{
+    return _state.planes;
+}
+
+uint8_t Chip8Interpreter::ReadMemory(uint16_t address) const
+{
+    return _memory[address & _memory_mask];
+}
+
+Chip8MachineState Chip8Interpreter::SaveState() const
+{
+    Chip8MachineState state = _state;
+
+    if (!_xo_memory.empty())
     {
-        throw std::invalid_argument("Invalid ROM file: Empty or too big for CHIP8");
+        std::copy_n(_xo_memory.begin(), C8_MEMORY_SIZE, state.memory.begin());
     }
 
-    for (auto i = 0; i < binary.size(); i++)
+    return state;
+}
+
+void Chip8Interpreter::LoadState(const Chip8MachineState& state)
+{
+    _state = state;
+    _draw_flag = true;
+
+    if (_trace_writer != nullptr)
+    {
+        _trace_writer->Resynchronize(GetTraceState());
+    }
+
+    if (!_xo_memory.empty())
+    {
+        std::copy(state.memory.begin(), state.memory.end(), _xo_memory.begin());
+    }
+}
+
+std::vector<uint8_t> Chip8Interpreter::SaveExtendedMemory() const
+{
+    if (_xo_memory.empty())
     {
-        _memory[i + 0x200] = binary[i];
+        return {};
     }
+
+    return {_xo_memory.begin() + C8_MEMORY_SIZE, _xo_memory.end()};
+}
+
+void Chip8Interpreter::LoadExtendedMemory(const std::vector<uint8_t>& extended_memory)
+{
+    if (extended_memory.size() + C8_MEMORY_SIZE != (_xo_memory.empty() ? C8_MEMORY_SIZE : _xo_memory.size()))
+    {
+        throw std::invalid_argument("Extended memory was saved by a different variant");
+    }
+
+    std::copy(extended_memory.begin(), extended_memory.end(), _xo_memory.begin() + C8_MEMORY_SIZE);
+}
+
+void Chip8Interpreter::LoadROM(const std::vector<uint8_t>& binary)
+{
+    LoadROM(binary.data(), binary.size());
+}
+
+void Chip8Interpreter::LoadROM(const uint8_t* binary, size_t size)
+{
+    if (size > _memory_mask + 1 - 0x200 || size == 0)
+    {
+        throw std::invalid_argument("Invalid ROM file: Empty or too big for CHIP8");
+    }
+
+    std::copy_n(binary, size, _memory + 0x200);
 }
 
 Chip8FrameBuffer& Chip8Interpreter::AccessFrameBuffer()
 {
-    return _frame_buffer;
+    return _state.frame_buffer;
 }
 
 void Chip8Interpreter::HandleKeyEvent(CalicoEvent event, CalicoKey key)
@@ -38,28 +194,28 @@ void Chip8Interpreter::HandleKeyEvent(CalicoEvent event, CalicoKey key)
 
     int key_index = static_cast<int>(key);
 
-    _keypad_status[key_index] = event == CalicoEvent::KeyDown;
+    _state.keypad_status[key_index] = event == CalicoEvent::KeyDown;
 }
 
 void Chip8Interpreter::TickDelayTimer()
 {
-    if (_timers.delay > 0)
+    if (_state.delay > 0)
     {
-        _timers.delay--;
+        _state.delay--;
     }
 }
 
 void Chip8Interpreter::TickSoundTimer()
 {
-    if (_timers.sound > 0)
+    if (_state.sound > 0)
     {
-        _timers.sound--;
+        _state.sound--;
     }
 }
 
 bool Chip8Interpreter::ShouldPlaySound() const
 {
-    return _timers.sound != 0;
+    return _state.sound != 0;
 }
 
 bool Chip8Interpreter::DrawFlag()
@@ -74,79 +230,357 @@ void Chip8Interpreter::DrawFlag(bool new_val)
 
 uint8_t Chip8Interpreter::GetXFromOpcode() const
 {
-    return (_current_opcode & 0x0F00) >> 8;
+    return DecodeXFromOpcode(_current_opcode);
 }
 
 uint8_t Chip8Interpreter::GetYFromOpcode() const
 {
-    return (_current_opcode & 0x00F0) >> 4;
+    return DecodeYFromOpcode(_current_opcode);
 }
 
 uint16_t Chip8Interpreter::GetNNNFromOpcode() const
 {
-    return _current_opcode & 0x0FFF;
+    return DecodeNNNFromOpcode(_current_opcode);
 }
 
 uint8_t Chip8Interpreter::GetNNFromOpcode() const
 {
-    return _current_opcode & 0x00FF;
+    return DecodeNNFromOpcode(_current_opcode);
 }
 
 uint8_t Chip8Interpreter::GetNFromOpcode() const
 {
-    return _current_opcode & 0x000F;
+    return DecodeNFromOpcode(_current_opcode);
 }
 
 void Chip8Interpreter::Draw(int x, int y, int height)
 {
-    const uint8_t x_cord = _registers.general[x];
-    const uint8_t y_cord = _registers.general[y];
+    // Classic sprites wrap around the screen edges, SUPER-CHIP/XO-CHIP only wrap the starting position and clip
+    bool wrap = _variant == Chip8Variant::Chip8;
+
+    int x_cord = _state.general[x] % _state.frame_buffer.GetWidth();
+    int y_cord = wrap ? _state.general[y] : _state.general[y] % _state.frame_buffer.GetHeight();
+
+    // Dxy0 draws 16x16 sprites, two bytes per row
+    int sprite_width = 8;
+    if (height == 0 && _variant != Chip8Variant::Chip8)
+    {
+        height = 16;
+        sprite_width = 16;
+    }
 
-    bool pixel_flipped = false;
+    uint32_t address = _state.i;
+    int collided_rows = 0;
 
-    for (auto diff_y = 0; diff_y < height; diff_y++)
+    // With both XO-CHIP planes selected the sprite data for the second one follows the first
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
     {
-        uint8_t r = _memory[_registers.i + diff_y];
+        if ((_state.planes & (1 << plane)) == 0)
+        {
+            continue;
+        }
 
-        for (auto diff_x = 0; diff_x < 8; diff_x++)
+        for (auto diff_y = 0; diff_y < height; diff_y++)
         {
-            if ((r & (1 << (7 - diff_x))) != 0)
+            uint16_t row = sprite_width == 16 ? (Memory(address) << 8) | Memory(address + 1) : Memory(address);
+            address += sprite_width / 8;
+
+            if (row != 0 && _state.frame_buffer.DrawSpriteRow(x_cord, y_cord + diff_y, row, sprite_width, plane, wrap))
             {
-                _frame_buffer.FlipPixel(x_cord + diff_x, y_cord + diff_y);
-                if (!_frame_buffer.GetPixelFrom2DCords(x_cord + diff_x, y_cord + diff_y))
-                {
-                    pixel_flipped = true;
-                }
+                collided_rows++;
             }
         }
     }
 
     _draw_flag = true;
-    _registers.general[0xF] = pixel_flipped;
+
+    // SUPER-CHIP reports number of colliding rows in high resolution
+    _state.general[0xF] = _variant == Chip8Variant::SuperChip && _state.frame_buffer.IsHighResolution()
+                              ? collided_rows : collided_rows != 0;
+}
+
+void Chip8Interpreter::SkipNextInstruction()
+{
+    // F000 nnnn is the only 4 byte instruction
+    bool long_instruction = _variant == Chip8Variant::XOChip && Memory(_state.pc) == 0xF0 &&
+                            Memory(_state.pc + 1) == 0x00;
+
+    _state.pc += long_instruction ? 4 : 2;
+}
+
+bool Chip8Interpreter::ExecuteExtendedSystemInstruction()
+{
+    if ((_current_opcode & 0xFFF0) == 0x00C0)
+    {
+        _state.frame_buffer.ScrollDown(GetNFromOpcode(), _state.planes);
+        _draw_flag = true;
+
+        return true;
+    }
+
+    if ((_current_opcode & 0xFFF0) == 0x00D0 && _variant == Chip8Variant::XOChip)
+    {
+        _state.frame_buffer.ScrollUp(GetNFromOpcode(), _state.planes);
+        _draw_flag = true;
+
+        return true;
+    }
+
+    switch (_current_opcode)
+    {
+        case 0x00FB:
+            _state.frame_buffer.ScrollRight(4, _state.planes);
+            break;
+
+        case 0x00FC:
+            _state.frame_buffer.ScrollLeft(4, _state.planes);
+            break;
+
+        // Exit, the interpreter stays on it
+        case 0x00FD:
+            _state.pc -= 2;
+            return true;
+
+        case 0x00FE:
+            _state.frame_buffer.SetHighResolution(false);
+            break;
+
+        case 0x00FF:
+            _state.frame_buffer.SetHighResolution(true);
+            break;
+
+        default:
+            return false;
+    }
+
+    _draw_flag = true;
+
+    return true;
+}
+
+bool Chip8Interpreter::ExecuteExtendedMiscInstruction()
+{
+    bool xo_chip = _variant == Chip8Variant::XOChip;
+
+    switch (_current_opcode & 0x00FF)
+    {
+        // F000 nnnn, I = nnnn
+        case 0x00:
+            if (!xo_chip || GetXFromOpcode() != 0)
+            {
+                return false;
+            }
+
+            _state.i = (Memory(_state.pc) << 8) | Memory(_state.pc + 1);
+            _state.pc += 2;
+            break;
+
+        case 0x01:
+            if (!xo_chip)
+            {
+                return false;
+            }
+
+            _state.planes = GetXFromOpcode() & 0x3;
+            break;
+
+        case 0x02:
+            if (!xo_chip || GetXFromOpcode() != 0)
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < _state.audio_pattern.size(); i++)
+            {
+                _state.audio_pattern[i] = Memory(_state.i + i);
+            }
+            break;
+
+        case 0x30:
+            _state.i = C8_BIG_FONT_ADDRESS + (_state.general[GetXFromOpcode()] & 0xF) * 10;
+            break;
+
+        case 0x3A:
+            if (!xo_chip)
+            {
+                return false;
+            }
+
+            _state.pitch = _state.general[GetXFromOpcode()];
+            break;
+
+        // SUPER-CHIP only has 8 flags
+        case 0x75:
+            for (auto i = 0; i <= GetXFromOpcode() && (xo_chip || i < 8); i++)
+            {
+                _state.rpl_flags[i] = _state.general[i];
+            }
+            break;
+
+        case 0x85:
+            for (auto i = 0; i <= GetXFromOpcode() && (xo_chip || i < 8); i++)
+            {
+                _state.general[i] = _state.rpl_flags[i];
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
 }
 
 void Chip8Interpreter::FunctionCall(uint16_t address)
 {
-    _stack.push(_registers.pc);
-    _registers.pc = address;
+    if (_state.stack_pointer == C8_STACK_SIZE)
+    {
+        throw std::overflow_error("Call stack overflow at PC=" + std::to_string(_state.pc - 2));
+    }
+
+    _state.stack[_state.stack_pointer++] = _state.pc;
+    _state.pc = address;
 }
 
 void Chip8Interpreter::FunctionReturn()
 {
-    // TODO is there exception for top when empty? If not then crash
-    if (_stack.empty())
+    if (_state.stack_pointer == 0)
     {
-        throw std::underflow_error("Call stack underflow at PC=" + std::to_string(_registers.pc - 2));
+        throw std::underflow_error("Call stack underflow at PC=" + std::to_string(_state.pc - 2));
     }
 
-    _registers.pc = _stack.top();
-    _stack.pop();
+    // Popped entries are cleared so equal machines stay equal byte for byte
+    _state.pc = _state.stack[--_state.stack_pointer];
+    _state.stack[_state.stack_pointer] = 0;
+}
+
+void Chip8Interpreter::StartTrace(const std::string& path)
+{
+    _trace_writer = std::make_unique<Chip8TraceWriter>(path, GetTraceState());
+}
+
+Chip8TraceStep Chip8Interpreter::GetTraceState() const
+{
+    Chip8TraceStep state{};
+    state.pc = _state.pc;
+    state.general = _state.general;
+    state.i = _state.i;
+    state.delay = _state.delay;
+    state.sound = _state.sound;
+
+    return state;
+}
+
+void Chip8Interpreter::StopTrace()
+{
+    _trace_writer.reset();
 }
 
 void Chip8Interpreter::ExecuteNextInstruction()
 {
-    _current_opcode = (_memory[_registers.pc] << 8) | _memory[_registers.pc + 1];
-    _registers.pc += 2;
+    if (_trace_writer == nullptr)
+    {
+        ExecuteInstruction();
+        return;
+    }
+
+    ExecuteTracedInstruction();
+}
+
+void Chip8Interpreter::ExecuteTracedInstruction()
+{
+    uint16_t pc = _state.pc;
+    uint16_t i = _state.i;
+
+    // The instruction that failed is what a trace is usually read for, so it's recorded before rethrowing
+    try
+    {
+        ExecuteInstruction();
+    }
+    catch (...)
+    {
+        RecordTraceStep(pc, i);
+        throw;
+    }
+
+    RecordTraceStep(pc, i);
+}
+
+void Chip8Interpreter::RecordTraceStep(uint16_t pc, uint16_t previous_i)
+{
+    Chip8TraceRawRecord record{pc, _current_opcode, _state.general[GetXFromOpcode()], _state.general[0xF],
+                               _state.delay, _state.sound};
+
+    if (!HasTraceFlags(_current_opcode))
+    {
+        StoreRawSlot(_trace_writer->Reserve(sizeof(record)), &record);
+        return;
+    }
+
+    uint8_t flags = GetTraceFlags(previous_i);
+    record.vf_or_flags = flags;
+
+    uint8_t* output = _trace_writer->Reserve(GetRawRecordSize(flags));
+    StoreRawSlot(output, &record);
+    output += C8_TRACE_RAW_SLOT_SIZE;
+
+    if ((flags & C8_TRACE_RAW_I) != 0)
+    {
+        uint64_t i = _state.i;
+        StoreRawSlot(output, &i);
+        output += C8_TRACE_RAW_SLOT_SIZE;
+    }
+
+    if ((flags & C8_TRACE_RAW_LOW_REGISTERS) != 0)
+    {
+        StoreRawSlot(output, _state.general.data());
+        output += C8_TRACE_RAW_SLOT_SIZE;
+    }
+
+    if ((flags & C8_TRACE_RAW_HIGH_REGISTERS) != 0)
+    {
+        StoreRawSlot(output, _state.general.data() + C8_TRACE_RAW_SLOT_SIZE);
+    }
+}
+
+uint8_t Chip8Interpreter::GetTraceFlags(uint16_t previous_i) const
+{
+    uint8_t flags = _state.i != previous_i ? C8_TRACE_RAW_I : 0;
+
+    if ((_current_opcode & 0xF000) == 0xF000)
+    {
+        switch (_current_opcode & 0x00FF)
+        {
+            // Only Fx33, Fx55 and XO-CHIP 5xy2 write to memory
+            case 0x33:
+            case 0x55:
+                flags |= C8_TRACE_RAW_WRITE;
+                break;
+
+            // Fx65, Fx85 and XO-CHIP 5xy3 load several registers at once
+            case 0x65:
+            case 0x85:
+                flags |= C8_TRACE_RAW_LOW_REGISTERS | (GetXFromOpcode() >= 8 ? C8_TRACE_RAW_HIGH_REGISTERS : 0);
+                break;
+        }
+    }
+    else if (_variant == Chip8Variant::XOChip && GetNFromOpcode() == 2)
+    {
+        flags |= C8_TRACE_RAW_WRITE;
+    }
+    else if (_variant == Chip8Variant::XOChip && GetNFromOpcode() == 3)
+    {
+        flags |= (std::min(GetXFromOpcode(), GetYFromOpcode()) < 8 ? C8_TRACE_RAW_LOW_REGISTERS : 0) |
+                 (std::max(GetXFromOpcode(), GetYFromOpcode()) >= 8 ? C8_TRACE_RAW_HIGH_REGISTERS : 0);
+    }
+
+    return flags;
+}
+
+void Chip8Interpreter::ExecuteInstruction()
+{
+    _current_opcode = (Memory(_state.pc) << 8) | Memory(_state.pc + 1);
+    _state.pc += 2;
 
     switch (_current_opcode & 0xF000)
     {
@@ -158,19 +592,21 @@ void Chip8Interpreter::ExecuteNextInstruction()
                     break;
 
                 case 0x00e0:
-                    _frame_buffer.Clear();
+                    _state.frame_buffer.Clear(_state.planes);
                     _draw_flag = true;
                     break;
 
-
                 default:
-                    FunctionCall(GetNNNFromOpcode());
+                    if (_variant == Chip8Variant::Chip8 || !ExecuteExtendedSystemInstruction())
+                    {
+                        FunctionCall(GetNNNFromOpcode());
+                    }
                     break;
             }
             break;
 
         case 0x1000:
-            _registers.pc = GetNNNFromOpcode();
+            _state.pc = GetNNNFromOpcode();
             break;
 
         case 0x2000:
@@ -178,117 +614,143 @@ void Chip8Interpreter::ExecuteNextInstruction()
             break;
 
         case 0x3000:
-            if (_registers.general[GetXFromOpcode()] == GetNNFromOpcode())
+            if (_state.general[GetXFromOpcode()] == GetNNFromOpcode())
             {
-                _registers.pc += 2;
+                SkipNextInstruction();
             }
             break;
 
         case 0x4000:
-            if (_registers.general[GetXFromOpcode()] != GetNNFromOpcode())
+            if (_state.general[GetXFromOpcode()] != GetNNFromOpcode())
             {
-                _registers.pc += 2;
+                SkipNextInstruction();
             }
             break;
 
         case 0x5000:
-            if (_registers.general[GetXFromOpcode()] == _registers.general[GetYFromOpcode()])
+            // XO-CHIP 5xy2/5xy3 save/load Vx to Vy in either direction at I
+            if (_variant == Chip8Variant::XOChip && (GetNFromOpcode() == 2 || GetNFromOpcode() == 3))
             {
-                _registers.pc += 2;
+                int step = GetXFromOpcode() <= GetYFromOpcode() ? 1 : -1;
+
+                for (int reg = GetXFromOpcode(), offset = 0;; reg += step, offset++)
+                {
+                    if (GetNFromOpcode() == 2)
+                    {
+                        Memory(_state.i + offset) = _state.general[reg];
+                    }
+                    else
+                    {
+                        _state.general[reg] = Memory(_state.i + offset);
+                    }
+
+                    if (reg == GetYFromOpcode())
+                    {
+                        break;
+                    }
+                }
+            }
+            else if (_state.general[GetXFromOpcode()] == _state.general[GetYFromOpcode()])
+            {
+                SkipNextInstruction();
             }
             break;
 
         case 0x6000:
-            _registers.general[GetXFromOpcode()] = GetNNFromOpcode();
+            _state.general[GetXFromOpcode()] = GetNNFromOpcode();
             break;
 
         case 0x7000:
-            _registers.general[GetXFromOpcode()] = _registers.general[GetXFromOpcode()] + GetNNFromOpcode();
+            _state.general[GetXFromOpcode()] = _state.general[GetXFromOpcode()] + GetNNFromOpcode();
             break;
 
         case 0x8000:
             switch (_current_opcode & 0x000F)
             {
                 case 0x0:
-                    _registers.general[GetXFromOpcode()] = _registers.general[GetYFromOpcode()];
+                    _state.general[GetXFromOpcode()] = _state.general[GetYFromOpcode()];
                     break;
 
                 case 0x1:
-                    _registers.general[GetXFromOpcode()] |= _registers.general[GetYFromOpcode()];
+                    _state.general[GetXFromOpcode()] |= _state.general[GetYFromOpcode()];
                     break;
 
                 case 0x2:
-                    _registers.general[GetXFromOpcode()] &= _registers.general[GetYFromOpcode()];
+                    _state.general[GetXFromOpcode()] &= _state.general[GetYFromOpcode()];
                     break;
 
                 case 0x3:
-                    _registers.general[GetXFromOpcode()] ^= _registers.general[GetYFromOpcode()];
+                    _state.general[GetXFromOpcode()] ^= _state.general[GetYFromOpcode()];
                     break;
 
                 case 0x4:
                 {
-                    uint16_t res = _registers.general[GetXFromOpcode()] + _registers.general[GetYFromOpcode()];
+                    uint16_t res = _state.general[GetXFromOpcode()] + _state.general[GetYFromOpcode()];
 
-                    _registers.general[GetXFromOpcode()] = res;
-                    _registers.general[0xF] = res > 0xFF;
+                    _state.general[GetXFromOpcode()] = res;
+                    _state.general[0xF] = res > 0xFF;
                 }
                     break;
 
                 case 0x5:
                 {
-                    uint16_t res = _registers.general[GetXFromOpcode()] - _registers.general[GetYFromOpcode()];
+                    uint16_t res = _state.general[GetXFromOpcode()] - _state.general[GetYFromOpcode()];
 
-                    _registers.general[GetXFromOpcode()] = res % 0x100;
-                    _registers.general[0xF] = res >= 0;
+                    _state.general[GetXFromOpcode()] = res % 0x100;
+                    _state.general[0xF] = res >= 0;
                 }
                     break;
 
                 case 0x6:
-                    _registers.general[0xF] = (_registers.general[GetXFromOpcode()] & 1) == 1;
-                    _registers.general[GetXFromOpcode()] >>= 1;
+                    _state.general[0xF] = (_state.general[GetXFromOpcode()] & 1) == 1;
+                    _state.general[GetXFromOpcode()] >>= 1;
                     break;
 
                 case 0x7:
                 {
-                    uint16_t res = _registers.general[GetYFromOpcode()] - _registers.general[GetXFromOpcode()];
+                    uint16_t res = _state.general[GetYFromOpcode()] - _state.general[GetXFromOpcode()];
 
-                    _registers.general[GetXFromOpcode()] = res % 0x100;
-                    _registers.general[0xF] = res >= 0;
+                    _state.general[GetXFromOpcode()] = res % 0x100;
+                    _state.general[0xF] = res >= 0;
                 }
                     break;
 
                 case 0xE:
-                    _registers.general[0xF] = (_registers.general[GetXFromOpcode()] & 0b10000000) == 0b10000000;
-                    _registers.general[GetXFromOpcode()] <<= 1;
+                    _state.general[0xF] = (_state.general[GetXFromOpcode()] & 0b10000000) == 0b10000000;
+                    _state.general[GetXFromOpcode()] <<= 1;
                     break;
 
                 default:
                     throw std::runtime_error("Invalid opcode (" + std::to_string(_current_opcode) +
-                                             ") at PC=(" + std::to_string(_registers.pc) + ")");
+                                             ") at PC=(" + std::to_string(_state.pc) + ")");
 
             }
             break;
 
         case 0x9000:
-            if (_registers.general[GetXFromOpcode()] != _registers.general[GetYFromOpcode()])
+            if (_state.general[GetXFromOpcode()] != _state.general[GetYFromOpcode()])
             {
-                _registers.pc += 2;
+                SkipNextInstruction();
             }
             break;
 
         case 0xA000:
-            _registers.i = GetNNNFromOpcode();
+            _state.i = GetNNNFromOpcode();
             break;
 
         case 0xB000:
-            _registers.pc = GetNNNFromOpcode() + _registers.general[0];
+            // SUPER-CHIP jumps to xnn + Vx
+            _state.pc = GetNNNFromOpcode() +
+                            _state.general[_variant == Chip8Variant::SuperChip ? GetXFromOpcode() : 0];
             break;
 
         case 0xC000:
         {
-            srand(static_cast <unsigned int> (time(nullptr)));
+            _state.random_state ^= _state.random_state << 13;
+            _state.random_state ^= _state.random_state >> 17;
+            _state.random_state ^= _state.random_state << 5;
 
-            _registers.general[GetXFromOpcode()] = (rand() % 0x100) & GetNNFromOpcode();
+            _state.general[GetXFromOpcode()] = (_state.random_state % 0x100) & GetNNFromOpcode();
         }
             break;
 
@@ -297,25 +759,26 @@ void Chip8Interpreter::ExecuteNextInstruction()
             break;
 
         case 0xE000:
+            // Only the low nibble of Vx selects a key, like other interpreters do
             switch (_current_opcode & 0x00FF)
             {
                 case 0x9E:
-                    if (_keypad_status[_registers.general[GetXFromOpcode()]])
+                    if (_state.keypad_status[_state.general[GetXFromOpcode()] & 0xF])
                     {
-                        _registers.pc += 2;
+                        SkipNextInstruction();
                     }
                     break;
 
                 case 0xA1:
-                    if (!_keypad_status[_registers.general[GetXFromOpcode()]])
+                    if (!_state.keypad_status[_state.general[GetXFromOpcode()] & 0xF])
                     {
-                        _registers.pc += 2;
+                        SkipNextInstruction();
                     }
                     break;
 
                 default:
                     throw std::runtime_error("Invalid opcode (" + std::to_string(_current_opcode) +
-                                             ") at PC=(" + std::to_string(_registers.pc) + ")");
+                                             ") at PC=(" + std::to_string(_state.pc) + ")");
             }
             break;
 
@@ -323,7 +786,7 @@ void Chip8Interpreter::ExecuteNextInstruction()
             switch (_current_opcode & 0x00FF)
             {
                 case 0x07:
-                    _registers.general[GetXFromOpcode()] = _timers.delay;
+                    _state.general[GetXFromOpcode()] = _state.delay;
                     break;
 
                 case 0x0A:
@@ -332,9 +795,9 @@ void Chip8Interpreter::ExecuteNextInstruction()
 
                     for (auto i = 0; i < 16; i++)
                     {
-                        if (_keypad_status[i])
+                        if (_state.keypad_status[i])
                         {
-                            _registers.general[GetXFromOpcode()] = i;
+                            _state.general[GetXFromOpcode()] = i;
                             key_pressed = true;
                         }
                     }
@@ -342,57 +805,62 @@ void Chip8Interpreter::ExecuteNextInstruction()
                     // If not pressed, stay on this instruction
                     if (!key_pressed)
                     {
-                        _registers.pc -= 2;
+                        _state.pc -= 2;
                     }
                 }
 
                 case 0x15:
-                    _timers.delay = _registers.general[GetXFromOpcode()];
+                    _state.delay = _state.general[GetXFromOpcode()];
                     break;
 
                 case 0x18:
-                    _timers.sound = _registers.general[GetXFromOpcode()];
+                    _state.sound = _state.general[GetXFromOpcode()];
 
                 case 0x1E:
-                    _registers.i += _registers.general[GetXFromOpcode()];
+                    _state.i += _state.general[GetXFromOpcode()];
                     break;
 
                 case 0x29:
-                    _registers.i = _registers.general[GetXFromOpcode()] * 5;
+                    _state.i = _state.general[GetXFromOpcode()] * 5;
                     break;
 
                 case 0x33:
                 {
-                    uint8_t reg_x = _registers.general[GetXFromOpcode()];
+                    uint8_t reg_x = _state.general[GetXFromOpcode()];
 
-                    _memory[_registers.i] = reg_x / 100;
-                    _memory[_registers.i + 1] = (reg_x / 10) % 10;
-                    _memory[_registers.i + 2] = reg_x % 10;
+                    Memory(_state.i) = reg_x / 100;
+                    Memory(_state.i + 1) = (reg_x / 10) % 10;
+                    Memory(_state.i + 2) = reg_x % 10;
                 }
                     break;
 
                 case 0x55:
                     for (auto i = 0; i <= GetXFromOpcode(); i++)
                     {
-                        _memory[_registers.i + i] = _registers.general[i];
+                        Memory(_state.i + i) = _state.general[i];
                     }
                     break;
 
                 case 0x65:
                     for (auto i = 0; i <= GetXFromOpcode(); i++)
                     {
-                        _registers.general[i] = _memory[_registers.i + i];
+                        _state.general[i] = Memory(_state.i + i);
                     }
                     break;
 
                 default:
+                    if (_variant != Chip8Variant::Chip8 && ExecuteExtendedMiscInstruction())
+                    {
+                        break;
+                    }
+
                     throw std::runtime_error("Invalid opcode (" + std::to_string(_current_opcode) +
-                                             ") at PC=(" + std::to_string(_registers.pc - 2) + ")");
+                                             ") at PC=(" + std::to_string(_state.pc - 2) + ")");
             }
             break;
 
         default:
             throw std::runtime_error("Invalid opcode (" + std::to_string(_current_opcode) +
-                                     ") at PC=(" + std::to_string(_registers.pc - 2) + ")");
+                                     ") at PC=(" + std::to_string(_state.pc - 2) + ")");
     }
 }
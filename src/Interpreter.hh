@@ -4,10 +4,18 @@
 #include <cstdint>
 #include <vector>
 #include <array>
-#include <stack>
+#include <cstddef>
+#include <type_traits>
+#include <memory>
+#include <string>
 #include "FrameBuffer.hh"
+#include "Trace.hh"
 
 constexpr int C8_MEMORY_SIZE = 4096;
+constexpr int C8_XO_MEMORY_SIZE = 65536;
+
+constexpr uint16_t C8_FONT_ADDRESS = 0x050;
+constexpr uint16_t C8_BIG_FONT_ADDRESS = 0x0A0;
 
 static constexpr std::array<uint8_t, 80> C8_FONTSET
         {
@@ -29,6 +37,43 @@ static constexpr std::array<uint8_t, 80> C8_FONTSET
                 0xF0, 0x80, 0xF0, 0x80, 0x80,
         };
 
+// SUPER-CHIP 1.1 digits 0-9 extended with XO-CHIP A-F, 8x10 each
+static constexpr std::array<uint8_t, 160> C8_BIG_FONTSET
+        {
+                0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C,
+                0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C,
+                0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF,
+                0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C,
+                0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06,
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C,
+                0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C,
+                0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60,
+                0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C,
+                0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C,
+                0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,
+                0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,
+                0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,
+                0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+                0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0,
+        };
+
+enum class Chip8Variant
+{
+    Chip8,
+    // 128x64 mode, scrolling, 16x16 sprites, big font and RPL flags, sprites clip at screen edges
+    SuperChip,
+    // SUPER-CHIP plus 64 KB memory, two bitplanes, scrolling up and 4 byte F000 nnnn
+    XOChip
+};
+
+// Accepts 'chip8', 'schip' and 'xochip'
+Chip8Variant ParseChip8Variant(const std::string& name);
+std::string FormatChip8Variant(Chip8Variant variant);
+
+// Keyboard character of every keypad key, in CalicoKey order
+constexpr const char* C8_DEFAULT_KEYMAP = "1234qwerasdfzxcv";
+
 enum class CalicoKey
 {
     // MK = MainKeyboard
@@ -58,12 +103,83 @@ enum class CalicoEvent
     Invalid
 };
 
+constexpr uint8_t DecodeXFromOpcode(uint16_t opcode)
+{
+    return (opcode & 0x0F00) >> 8;
+}
+
+constexpr uint8_t DecodeYFromOpcode(uint16_t opcode)
+{
+    return (opcode & 0x00F0) >> 4;
+}
+
+constexpr uint16_t DecodeNNNFromOpcode(uint16_t opcode)
+{
+    return opcode & 0x0FFF;
+}
+
+constexpr uint8_t DecodeNNFromOpcode(uint16_t opcode)
+{
+    return opcode & 0x00FF;
+}
+
+constexpr uint8_t DecodeNFromOpcode(uint16_t opcode)
+{
+    return opcode & 0x000F;
+}
+
+constexpr int C8_STACK_SIZE = 16;
+
+// Everything that affects execution in one flat block, copying, comparing or hashing a machine is a single pass
+// over it. Registers, stack and keypad come first so an instruction usually touches two cache lines besides memory.
+// Reserved bytes stand in for padding and are always zero, so the raw bytes of equal states are equal.
+struct Chip8MachineState
+{
+    std::array<uint8_t, 16> general{0};
+    uint16_t pc = 0x200;
+    uint16_t i = 0x00;
+    uint8_t delay = 0x00;
+    uint8_t sound = 0x00;
+    uint8_t stack_pointer = 0;
+    // Selected XO-CHIP bitplanes, classic programs only draw to the first one
+    uint8_t planes = 1;
+    uint8_t pitch = 64;
+    uint8_t reserved[3]{0};
+    // Xorshift state for Cxnn, per machine so machines started with the same seed stay in lockstep
+    uint32_t random_state = 1;
+    std::array<uint8_t, 16> keypad_status{0};
+    std::array<uint8_t, 16> rpl_flags{0};
+
+    // Entries at and above stack_pointer are always zero
+    std::array<uint16_t, C8_STACK_SIZE> stack{0};
+    // XO-CHIP audio pattern, kept for completeness of the machine state
+    std::array<uint8_t, 16> audio_pattern{0};
+
+    // XO-CHIP memory above 4 KB isn't part of the state, see SaveExtendedMemory
+    std::array<uint8_t, C8_MEMORY_SIZE> memory{0};
+    Chip8FrameBuffer frame_buffer{};
+};
+
+static_assert(std::is_trivially_copyable_v<Chip8MachineState> && std::is_standard_layout_v<Chip8MachineState>,
+              "Machine state needs to be copyable as raw memory");
+static_assert(std::has_unique_object_representations_v<Chip8MachineState>,
+              "Machine state can't have padding, equal states need equal bytes");
+static_assert(offsetof(Chip8MachineState, stack) == 64, "Registers, keypad and RPL flags fill the first cache line");
+
 class Chip8Interpreter
 {
 public:
-    Chip8Interpreter();
+    explicit Chip8Interpreter(Chip8Variant variant = Chip8Variant::Chip8);
+
+    // Memory pointer refers into the interpreter itself, machines are copied through SaveState instead
+    Chip8Interpreter(const Chip8Interpreter&) = delete;
+    Chip8Interpreter& operator=(const Chip8Interpreter&) = delete;
+
+    Chip8Variant GetVariant() const;
 
     void LoadROM(const std::vector<uint8_t>& binary);
+    // Copied straight into memory, ex. from a Chip8RomMapping
+    void LoadROM(const uint8_t* binary, size_t size);
     void HandleKeyEvent(CalicoEvent event, CalicoKey key);
 
     void TickDelayTimer();
@@ -87,28 +203,59 @@ public:
 
     void ExecuteNextInstruction();
 
+    uint16_t GetProgramCounter() const;
+    uint16_t GetIndexRegister() const;
+    uint8_t GetDelayTimer() const;
+    uint8_t GetSoundTimer() const;
+    uint8_t GetGeneralRegister(int index) const;
+    size_t GetStackDepth() const;
+    uint8_t GetSelectedPlanes() const;
+    uint8_t ReadMemory(uint16_t address) const;
+    Chip8MachineState SaveState() const;
+    void LoadState(const Chip8MachineState& state);
+    // XO-CHIP memory above the first 4 KB, empty for other variants
+    std::vector<uint8_t> SaveExtendedMemory() const;
+    void LoadExtendedMemory(const std::vector<uint8_t>& extended_memory);
+    void SeedRandom(uint32_t seed);
+
+    void StartTrace(const std::string& path);
+    void StopTrace();
+
 private:
-    Chip8FrameBuffer _frame_buffer{};
-    std::array<uint8_t, C8_MEMORY_SIZE> _memory{0};
-    std::stack<uint16_t> _stack;
-    std::array<bool, 16> _keypad_status{0};
+    void ExecuteInstruction();
+    void ExecuteTracedInstruction();
+    void RecordTraceStep(uint16_t pc, uint16_t previous_i);
+    uint8_t GetTraceFlags(uint16_t previous_i) const;
+    Chip8TraceStep GetTraceState() const;
 
-    uint16_t _current_opcode = 0x0000;
+    // Opcodes added by SUPER-CHIP/XO-CHIP in the 0nnn and Fxnn groups, false when the opcode isn't one of them
+    bool ExecuteExtendedSystemInstruction();
+    bool ExecuteExtendedMiscInstruction();
 
-    bool _draw_flag = false;
+    void SkipNextInstruction();
 
-    struct
+    // Wraps around instead of reading past the end
+    uint8_t& Memory(uint32_t address)
     {
-        std::array<uint8_t, 16> general{0};
-        uint16_t pc = 0x200;
-        uint16_t i = 0x00;
-    } _registers;
+        return _memory[address & _memory_mask];
+    }
 
-    struct
-    {
-        uint8_t delay = 0x00;
-        uint8_t sound = 0x00;
-    } _timers;
+    Chip8Variant _variant = Chip8Variant::Chip8;
+
+    // Line aligned so the register block really is a single cache line
+    alignas(64) Chip8MachineState _state{};
+
+    // Classic and SUPER-CHIP memory lives in the flat state, XO-CHIP runs from a separate 64 KB buffer whose first
+    // 4 KB are synced with the state on save and load. Either way every access is a single mask.
+    std::vector<uint8_t> _xo_memory;
+    uint8_t* _memory = _state.memory.data();
+    uint32_t _memory_mask = C8_MEMORY_SIZE - 1;
+
+    uint16_t _current_opcode = 0x0000;
+
+    bool _draw_flag = false;
+
+    std::unique_ptr<Chip8TraceWriter> _trace_writer;
 };
 
 #endif //CALICOC8_INTERPRETER_HH
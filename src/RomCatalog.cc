@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include "RomCatalog.hh"
+#include "RomFile.hh"
+
+constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87;
+constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4F;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9;
+constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63;
+constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5;
+
+static uint64_t RotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Compiles to a single load on little endian machines
+static uint64_t ReadLittleEndian(const uint8_t* data, int bytes)
+{
+    uint64_t value = 0;
+
+    for (auto i = 0; i < bytes; i++)
+    {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+
+    return value;
+}
+
+static uint64_t XXH64Round(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * XXH_PRIME64_2;
+
+    return RotateLeft(accumulator, 31) * XXH_PRIME64_1;
+}
+
+static uint64_t XXH64MergeRound(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= XXH64Round(0, accumulator);
+
+    return hash * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t HashXXH64(const uint8_t* data, size_t size, uint64_t seed)
+{
+    const uint8_t* end = data + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        uint64_t accumulators[4]{seed + XXH_PRIME64_1 + XXH_PRIME64_2, seed + XXH_PRIME64_2, seed,
+                                 seed - XXH_PRIME64_1};
+
+        for (; data + 32 <= end; data += 32)
+        {
+            for (auto lane = 0; lane < 4; lane++)
+            {
+                accumulators[lane] = XXH64Round(accumulators[lane], ReadLittleEndian(data + lane * 8, 8));
+            }
+        }
+
+        hash = RotateLeft(accumulators[0], 1) + RotateLeft(accumulators[1], 7) +
+               RotateLeft(accumulators[2], 12) + RotateLeft(accumulators[3], 18);
+
+        for (auto accumulator: accumulators)
+        {
+            hash = XXH64MergeRound(hash, accumulator);
+        }
+    }
+    else
+    {
+        hash = seed + XXH_PRIME64_5;
+    }
+
+    hash += size;
+
+    for (; data + 8 <= end; data += 8)
+    {
+        hash ^= XXH64Round(0, ReadLittleEndian(data, 8));
+        hash = RotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+    if (data + 4 <= end)
+    {
+        hash ^= ReadLittleEndian(data, 4) * XXH_PRIME64_1;
+        hash = RotateLeft(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        data += 4;
+    }
+
+    for (; data < end; data++)
+    {
+        hash ^= *data * XXH_PRIME64_5;
+        hash = RotateLeft(hash, 11) * XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+void ValidateKeymap(const std::string& keymap)
+{
+    bool valid = keymap.size() == 16;
+
+    for (size_t i = 0; i < keymap.size() && valid; i++)
+    {
+        auto key = static_cast<unsigned char>(keymap[i]);
+        valid = (std::islower(key) || std::isdigit(key)) && keymap.find(keymap[i]) == i;
+    }
+
+    if (!valid)
+    {
+        throw std::invalid_argument("Keymap needs 16 distinct lowercase letters or digits: " + keymap);
+    }
+}
+
+static std::string FormatHash(uint64_t hash)
+{
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(16) << hash;
+
+    return stream.str();
+}
+
+static int64_t GetModificationTime(const std::filesystem::path& path)
+{
+    return std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+static uint64_t HashRomFile(const std::filesystem::path& path)
+{
+    Chip8RomMapping rom(path.string());
+
+    return HashXXH64(rom.GetData(), rom.GetSize());
+}
+
+Chip8RomCatalog::Chip8RomCatalog(const std::string& directory)
+        : _directory(directory)
+{
+    if (!std::filesystem::is_directory(_directory))
+    {
+        throw std::invalid_argument("Invalid catalog directory: " + _directory);
+    }
+
+    LoadIndex();
+}
+
+void Chip8RomCatalog::LoadIndex()
+{
+    std::ifstream index(std::filesystem::path(_directory) / C8_CATALOG_INDEX_NAME);
+    if (!index.good())
+    {
+        return;
+    }
+
+    std::string line;
+    if (!std::getline(index, line) || line != C8_CATALOG_INDEX_HEADER)
+    {
+        throw std::runtime_error("Unsupported catalog index in " + _directory);
+    }
+
+    for (auto line_number = 2; std::getline(index, line); line_number++)
+    {
+        std::istringstream stream(line);
+        std::string kind;
+        std::string hash;
+        stream >> kind >> hash;
+
+        try
+        {
+            if (kind == "file")
+            {
+                Chip8CatalogFile file{};
+                file.hash = std::stoull(hash, nullptr, 16);
+                stream >> file.size >> file.modified;
+
+                if (stream.fail())
+                {
+                    throw std::invalid_argument(line);
+                }
+
+                // Path is the rest of the line, spaces included
+                stream.get();
+                std::getline(stream, file.path);
+
+                if (file.path.empty())
+                {
+                    throw std::invalid_argument(line);
+                }
+
+                _files_by_path[file.path] = _files.size();
+                _files.push_back(file);
+            }
+            else if (kind == "meta")
+            {
+                Chip8RomMetadata metadata{};
+                std::string variant;
+                stream >> variant >> metadata.clock_speed >> metadata.keymap;
+
+                if (stream.fail())
+                {
+                    throw std::invalid_argument(line);
+                }
+
+                metadata.variant = ParseChip8Variant(variant);
+                ValidateKeymap(metadata.keymap);
+
+                _metadata[std::stoull(hash, nullptr, 16)] = metadata;
+            }
+            else if (!kind.empty())
+            {
+                throw std::invalid_argument(line);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error("Corrupt catalog index in " + _directory + " at line " +
+                                     std::to_string(line_number));
+        }
+    }
+}
+
+size_t Chip8RomCatalog::Scan()
+{
+    std::vector<Chip8CatalogFile> files;
+    std::unordered_map<std::string, size_t> files_by_path;
+    size_t hashed_files = 0;
+
+    for (auto& entry: std::filesystem::recursive_directory_iterator(_directory))
+    {
+        // Anything that doesn't fit XO-CHIP memory can't be a ROM, the index itself included
+        if (!entry.is_regular_file() || entry.file_size() == 0 ||
+            entry.file_size() > C8_XO_MEMORY_SIZE - 0x200 ||
+            entry.path().filename().string().rfind(C8_CATALOG_INDEX_NAME, 0) == 0)
+        {
+            continue;
+        }
+
+        Chip8CatalogFile file{};
+        file.path = std::filesystem::relative(entry.path(), _directory).generic_string();
+        file.size = entry.file_size();
+        file.modified = GetModificationTime(entry.path());
+
+        auto known = _files_by_path.find(file.path);
+
+        if (known != _files_by_path.end() && _files[known->second].size == file.size &&
+            _files[known->second].modified == file.modified)
+        {
+            file.hash = _files[known->second].hash;
+        }
+        else
+        {
+            file.hash = HashRomFile(entry.path());
+            hashed_files++;
+        }
+
+        files_by_path[file.path] = files.size();
+        files.push_back(file);
+    }
+
+    _files = std::move(files);
+    _files_by_path = std::move(files_by_path);
+
+    return hashed_files;
+}
+
+void Chip8RomCatalog::Save() const
+{
+    auto index_path = std::filesystem::path(_directory) / C8_CATALOG_INDEX_NAME;
+    auto temporary_path = index_path;
+    temporary_path += ".tmp";
+
+    // Sorted so the index diffs nicely when kept under version control
+    std::vector<const Chip8CatalogFile*> files;
+    for (auto& file: _files)
+    {
+        files.push_back(&file);
+    }
+
+    std::sort(files.begin(), files.end(), [](auto* first, auto* second)
+    {
+        return first->path < second->path;
+    });
+
+    std::map<uint64_t, Chip8RomMetadata> metadata(_metadata.begin(), _metadata.end());
+
+    {
+        std::ofstream index(temporary_path, std::ios::trunc);
+
+        index << C8_CATALOG_INDEX_HEADER << "\n";
+
+        for (auto* file: files)
+        {
+            index << "file " << FormatHash(file->hash) << " " << file->size << " " << file->modified << " "
+                  << file->path << "\n";
+        }
+
+        for (auto& [hash, entry]: metadata)
+        {
+            index << "meta " << FormatHash(hash) << " " << FormatChip8Variant(entry.variant) << " "
+                  << entry.clock_speed << " " << entry.keymap << "\n";
+        }
+
+        if (!index.flush())
+        {
+            throw std::runtime_error("Unable to write catalog index " + temporary_path.string());
+        }
+    }
+
+    std::filesystem::rename(temporary_path, index_path);
+}
+
+uint64_t Chip8RomCatalog::HashFile(const std::string& path) const
+{
+    auto relative_path = std::filesystem::relative(path, _directory).generic_string();
+    auto known = _files_by_path.find(relative_path);
+
+    if (known != _files_by_path.end())
+    {
+        auto& file = _files[known->second];
+
+        if (std::filesystem::file_size(path) == file.size && GetModificationTime(path) == file.modified)
+        {
+            return file.hash;
+        }
+    }
+
+    return HashRomFile(path);
+}
+
+std::optional<Chip8RomMetadata> Chip8RomCatalog::FindMetadata(uint64_t hash) const
+{
+    auto metadata = _metadata.find(hash);
+    if (metadata == _metadata.end())
+    {
+        return std::nullopt;
+    }
+
+    return metadata->second;
+}
+
+void Chip8RomCatalog::SetMetadata(uint64_t hash, const Chip8RomMetadata& metadata)
+{
+    ValidateKeymap(metadata.keymap);
+
+    _metadata[hash] = metadata;
+}
+
+const std::vector<Chip8CatalogFile>& Chip8RomCatalog::GetFiles() const
+{
+    return _files;
+}
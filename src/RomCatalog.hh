@@ -0,0 +1,68 @@
+#ifndef CALICOC8_ROMCATALOG_HH
+#define CALICOC8_ROMCATALOG_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Interpreter.hh"
+
+// Kept next to the ROMs, plain text so metadata can be edited by hand as well
+constexpr const char* C8_CATALOG_INDEX_NAME = ".calico-catalog";
+constexpr const char* C8_CATALOG_INDEX_HEADER = "calico-catalog 1";
+
+uint64_t HashXXH64(const uint8_t* data, size_t size, uint64_t seed = 0);
+
+// Throws unless keymap has a distinct lowercase letter or digit for each of the 16 keys
+void ValidateKeymap(const std::string& keymap);
+
+struct Chip8RomMetadata
+{
+    Chip8Variant variant = Chip8Variant::Chip8;
+    uint32_t clock_speed = 600;
+    std::string keymap = C8_DEFAULT_KEYMAP;
+};
+
+// Size and modification time let rescans and lookups by path skip hashing unchanged files
+struct Chip8CatalogFile
+{
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    int64_t modified = 0;
+    // Relative to the catalog directory
+    std::string path;
+};
+
+// Files are indexed by content hash, metadata belongs to the hash so copies and renamed files share it and it
+// survives the file being removed from the directory
+class Chip8RomCatalog
+{
+public:
+    // Loads the index when the directory already has one, throws when it's corrupt
+    explicit Chip8RomCatalog(const std::string& directory);
+
+    // Hashes new and modified files and forgets removed ones, returns the number of hashed files
+    size_t Scan();
+
+    // Writes the index, replaced atomically so concurrent readers never see half of it
+    void Save() const;
+
+    // Path is resolved through the index when the file is unchanged, hashed otherwise
+    uint64_t HashFile(const std::string& path) const;
+
+    std::optional<Chip8RomMetadata> FindMetadata(uint64_t hash) const;
+    void SetMetadata(uint64_t hash, const Chip8RomMetadata& metadata);
+
+    const std::vector<Chip8CatalogFile>& GetFiles() const;
+
+private:
+    void LoadIndex();
+
+    std::string _directory;
+    std::vector<Chip8CatalogFile> _files;
+    std::unordered_map<std::string, size_t> _files_by_path;
+    std::unordered_map<uint64_t, Chip8RomMetadata> _metadata;
+};
+
+#endif //CALICOC8_ROMCATALOG_HH
@@ -0,0 +1,64 @@
+#include <exception>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "RomFile.hh"
+
+Chip8RomMapping::Chip8RomMapping(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::invalid_argument("Invalid ROM path: " + path);
+    }
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        close(fd);
+
+        throw std::invalid_argument("Invalid ROM path: " + path);
+    }
+
+    _size = file_stat.st_size;
+
+    // Zero length mappings aren't allowed, empty ROMs are rejected by LoadROM anyway
+    if (_size != 0)
+    {
+        _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (_data == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map ROM file " + path);
+    }
+}
+
+Chip8RomMapping::~Chip8RomMapping()
+{
+    if (_data != nullptr)
+    {
+        munmap(_data, _size);
+    }
+}
+
+const uint8_t* Chip8RomMapping::GetData() const
+{
+    return static_cast<const uint8_t*>(_data);
+}
+
+size_t Chip8RomMapping::GetSize() const
+{
+    return _size;
+}
+
+std::vector<uint8_t> ReadBinaryToVector(const std::string& path)
+{
+    Chip8RomMapping rom(path);
+
+    return {rom.GetData(), rom.GetData() + rom.GetSize()};
+}
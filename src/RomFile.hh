@@ -0,0 +1,29 @@
+#ifndef CALICOC8_ROMFILE_HH
+#define CALICOC8_ROMFILE_HH
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// Read only mapping of a whole ROM file, pages are shared with every other process loading the same ROM
+class Chip8RomMapping
+{
+public:
+    explicit Chip8RomMapping(const std::string& path);
+    ~Chip8RomMapping();
+
+    Chip8RomMapping(const Chip8RomMapping&) = delete;
+    Chip8RomMapping& operator=(const Chip8RomMapping&) = delete;
+
+    // Null for empty files
+    const uint8_t* GetData() const;
+    size_t GetSize() const;
+
+private:
+    void* _data = nullptr;
+    size_t _size = 0;
+};
+
+std::vector<uint8_t> ReadBinaryToVector(const std::string& path);
+
+#endif //CALICOC8_ROMFILE_HH
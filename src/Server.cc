@@ -0,0 +1,723 @@
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Server.hh"
+
+// epoll data of the two descriptors that aren't connections, connection ids start above them
+constexpr uint64_t SERVER_LISTEN_ID = 0;
+constexpr uint64_t SERVER_WAKE_ID = 1;
+
+constexpr int SERVER_MAX_EVENTS = 64;
+constexpr size_t SERVER_READ_SIZE = 64 * 1024;
+constexpr size_t SERVER_MAX_PENDING_OUTPUT = 4 * 1024 * 1024;
+
+Chip8Server::Chip8Server(const Chip8ServerSettings& settings)
+        : _settings(settings)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (_settings.socket_path.empty() || _settings.socket_path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument("Invalid server socket path: " + _settings.socket_path);
+    }
+
+    _settings.socket_path.copy(address.sun_path, _settings.socket_path.size());
+    unlink(_settings.socket_path.c_str());
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listen_fd < 0 || bind(_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(_listen_fd, SOMAXCONN) != 0)
+    {
+        if (_listen_fd >= 0)
+        {
+            close(_listen_fd);
+        }
+
+        throw std::runtime_error("Unable to listen on server socket " + _settings.socket_path + ": " +
+                                 strerror(errno));
+    }
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event listen_event{};
+    listen_event.events = EPOLLIN;
+    listen_event.data.u64 = SERVER_LISTEN_ID;
+
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.u64 = SERVER_WAKE_ID;
+
+    if (_epoll_fd < 0 || _wake_fd < 0 || epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _listen_fd, &listen_event) != 0 ||
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &wake_event) != 0)
+    {
+        close(_listen_fd);
+        close(_epoll_fd);
+        close(_wake_fd);
+        unlink(_settings.socket_path.c_str());
+
+        throw std::runtime_error("Unable to set up epoll for server socket " + _settings.socket_path);
+    }
+
+    _next_connection_id = SERVER_WAKE_ID + 1;
+    _running = true;
+
+    for (auto i = 0u; i < std::max(1u, _settings.workers); i++)
+    {
+        _shards.push_back(std::make_unique<Chip8ServerShard>());
+    }
+
+    for (auto& shard: _shards)
+    {
+        shard->worker = std::thread(&Chip8Server::WorkerThread, this, std::ref(*shard));
+    }
+}
+
+Chip8Server::~Chip8Server()
+{
+    for (auto& shard: _shards)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->stopping = true;
+        }
+
+        shard->commands_available.notify_one();
+        shard->worker.join();
+    }
+
+    for (auto& [connection_id, connection]: _connections)
+    {
+        close(connection.fd);
+    }
+
+    close(_listen_fd);
+    close(_epoll_fd);
+    close(_wake_fd);
+    unlink(_settings.socket_path.c_str());
+}
+
+void Chip8Server::Stop()
+{
+    _running = false;
+
+    uint64_t value = 1;
+    if (write(_wake_fd, &value, sizeof(value)) < 0)
+    {
+        // Counter can only be full when the I/O thread is already about to wake up
+    }
+}
+
+void Chip8Server::Run()
+{
+    epoll_event events[SERVER_MAX_EVENTS];
+
+    while (_running)
+    {
+        int event_count = epoll_wait(_epoll_fd, events, SERVER_MAX_EVENTS, -1);
+
+        if (event_count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::runtime_error(std::string("epoll_wait failed: ") + strerror(errno));
+        }
+
+        for (auto i = 0; i < event_count; i++)
+        {
+            uint64_t id = events[i].data.u64;
+
+            if (id == SERVER_LISTEN_ID)
+            {
+                AcceptConnections();
+            }
+            else if (id == SERVER_WAKE_ID)
+            {
+                uint64_t value;
+                while (read(_wake_fd, &value, sizeof(value)) > 0)
+                {
+                }
+
+                FlushReplies();
+            }
+            else
+            {
+                if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0)
+                {
+                    CloseConnection(id);
+                    continue;
+                }
+
+                if ((events[i].events & EPOLLIN) != 0)
+                {
+                    ReadConnection(id);
+                }
+
+                if ((events[i].events & EPOLLOUT) != 0)
+                {
+                    WriteConnection(id);
+                }
+            }
+        }
+    }
+}
+
+void Chip8Server::AcceptConnections()
+{
+    while (true)
+    {
+        int fd = accept4(_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        uint64_t connection_id = _next_connection_id++;
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = connection_id;
+
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        _connections[connection_id].fd = fd;
+        _connections[connection_id].events = EPOLLIN;
+    }
+}
+
+void Chip8Server::CloseConnection(uint64_t connection_id)
+{
+    auto connection = _connections.find(connection_id);
+    if (connection == _connections.end())
+    {
+        return;
+    }
+
+    close(connection->second.fd);
+    _connections.erase(connection);
+
+    // Answers to these are dropped, their connection is gone
+    for (auto owner = _session_owners.begin(); owner != _session_owners.end();)
+    {
+        if (owner->second != connection_id)
+        {
+            ++owner;
+            continue;
+        }
+
+        Chip8ServerCommand command{};
+        command.connection = connection_id;
+        command.header.type = Chip8ServerMessageType::DestroySession;
+        command.header.session = owner->first;
+
+        Forward(std::move(command));
+        owner = _session_owners.erase(owner);
+    }
+}
+
+void Chip8Server::ReadConnection(uint64_t connection_id)
+{
+    auto& connection = _connections.at(connection_id);
+    bool closed = false;
+
+    while (true)
+    {
+        size_t offset = connection.input.size();
+        connection.input.resize(offset + SERVER_READ_SIZE);
+
+        ssize_t received = recv(connection.fd, connection.input.data() + offset, SERVER_READ_SIZE, 0);
+        connection.input.resize(offset + std::max<ssize_t>(received, 0));
+
+        // Level triggered, whatever is left is read on the next round after the other connections had theirs
+        if (received > 0)
+        {
+            break;
+        }
+
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        closed = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+
+    size_t consumed = 0;
+
+    while (connection.input.size() - consumed >= sizeof(Chip8ServerMessageHeader))
+    {
+        Chip8ServerMessageHeader header{};
+        std::memcpy(&header, connection.input.data() + consumed, sizeof(header));
+
+        // Nothing sensible can follow a message that can't be framed
+        if (header.size > C8_SERVER_MAX_PAYLOAD)
+        {
+            closed = true;
+            break;
+        }
+
+        if (connection.input.size() - consumed < sizeof(header) + header.size)
+        {
+            break;
+        }
+
+        HandleRequest(connection_id, header, connection.input.data() + consumed + sizeof(header));
+        consumed += sizeof(header) + header.size;
+    }
+
+    connection.input.erase(connection.input.begin(), connection.input.begin() + consumed);
+
+    if (closed)
+    {
+        CloseConnection(connection_id);
+    }
+}
+
+void Chip8Server::WriteConnection(uint64_t connection_id)
+{
+    auto found = _connections.find(connection_id);
+    if (found == _connections.end())
+    {
+        return;
+    }
+
+    auto& connection = found->second;
+
+    while (connection.output_offset < connection.output.size())
+    {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.output_offset,
+                            connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+
+        // Closed from the hangup event instead, callers may still be using the connection
+        if (sent < 0)
+        {
+            shutdown(connection.fd, SHUT_RDWR);
+            connection.output.clear();
+            connection.output_offset = 0;
+
+            return;
+        }
+
+        connection.output_offset += sent;
+    }
+
+    // Written part is dropped once it's most of the buffer, so a client that always lags behind doesn't keep
+    // everything ever sent to it
+    if (connection.output_offset * 2 >= connection.output.size())
+    {
+        connection.output.erase(connection.output.begin(), connection.output.begin() + connection.output_offset);
+        connection.output_offset = 0;
+    }
+
+    // A client pipelining requests without reading the answers isn't read from until it caught up
+    size_t pending_output = connection.output.size() - connection.output_offset;
+    uint32_t events = (pending_output < SERVER_MAX_PENDING_OUTPUT ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+                      (pending_output > 0 ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+
+    if (events != connection.events)
+    {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+
+        epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+}
+
+void Chip8Server::HandleRequest(uint64_t connection_id, const Chip8ServerMessageHeader& header,
+                                const uint8_t* payload)
+{
+    Chip8ServerCommand command{};
+    command.connection = connection_id;
+    command.header = header;
+    command.payload.assign(payload, payload + header.size);
+
+    if (header.type == Chip8ServerMessageType::CreateSession)
+    {
+        Chip8ServerCreateRequest request{};
+
+        if (header.size != sizeof(request))
+        {
+            Reply(connection_id, header, Chip8ServerStatus::InvalidRequest);
+            return;
+        }
+
+        std::memcpy(&request, payload, sizeof(request));
+
+        if (request.variant > static_cast<uint8_t>(Chip8Variant::XOChip) || request.clock_speed == 0)
+        {
+            Reply(connection_id, header, Chip8ServerStatus::InvalidRequest);
+            return;
+        }
+
+        if (_session_owners.size() >= _settings.max_sessions)
+        {
+            Reply(connection_id, header, Chip8ServerStatus::TooManySessions);
+            return;
+        }
+
+        // Zero is never handed out, clients can use it for "no session"
+        while (_next_session_id == 0 || _session_owners.count(_next_session_id) != 0)
+        {
+            _next_session_id++;
+        }
+
+        command.header.session = _next_session_id++;
+        _session_owners[command.header.session] = connection_id;
+
+        Forward(std::move(command));
+        return;
+    }
+
+    auto owner = _session_owners.find(header.session);
+    // Rejected requests are still answered by the shard of the session, after what was sent before them
+    if (owner == _session_owners.end() || owner->second != connection_id)
+    {
+        command.status = Chip8ServerStatus::UnknownSession;
+        command.payload.clear();
+
+        Forward(std::move(command));
+        return;
+    }
+
+    bool valid;
+
+    switch (header.type)
+    {
+        case Chip8ServerMessageType::DestroySession:
+        case Chip8ServerMessageType::FetchFrame:
+            valid = header.size == 0;
+            break;
+        case Chip8ServerMessageType::LoadRom:
+            valid = header.size > 0;
+            break;
+        case Chip8ServerMessageType::Key:
+            valid = header.size == sizeof(Chip8ServerKeyRequest) && payload[0] < 16;
+            break;
+        case Chip8ServerMessageType::Step:
+        {
+            Chip8ServerStepRequest request{};
+            std::memcpy(&request, payload, std::min<size_t>(header.size, sizeof(request)));
+
+            valid = header.size == sizeof(request) && request.frames > 0 &&
+                    request.frames <= C8_SERVER_MAX_STEP_FRAMES;
+            break;
+        }
+        default:
+            valid = false;
+    }
+
+    if (!valid)
+    {
+        command.status = Chip8ServerStatus::InvalidRequest;
+        command.payload.clear();
+
+        Forward(std::move(command));
+        return;
+    }
+
+    if (header.type == Chip8ServerMessageType::DestroySession)
+    {
+        _session_owners.erase(owner);
+    }
+
+    Forward(std::move(command));
+}
+
+void Chip8Server::Reply(uint64_t connection_id, const Chip8ServerMessageHeader& request, Chip8ServerStatus status,
+                        const std::string& message)
+{
+    Chip8ServerMessageHeader header = request;
+    header.status = status;
+
+    AppendServerMessage(_connections.at(connection_id).output, header, message.data(), message.size());
+    WriteConnection(connection_id);
+}
+
+void Chip8Server::FlushReplies()
+{
+    Chip8ServerReplies replies;
+
+    {
+        std::lock_guard<std::mutex> lock(_replies_mutex);
+        replies.swap(_replies);
+    }
+
+    for (auto& [connection_id, bytes]: replies)
+    {
+        auto connection = _connections.find(connection_id);
+        if (connection == _connections.end())
+        {
+            continue;
+        }
+
+        auto& output = connection->second.output;
+        output.insert(output.end(), bytes.begin(), bytes.end());
+
+        WriteConnection(connection_id);
+    }
+}
+
+void Chip8Server::Forward(Chip8ServerCommand command)
+{
+    auto& shard = *_shards[command.header.session % _shards.size()];
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.commands.push_back(std::move(command));
+    }
+
+    shard.commands_available.notify_one();
+}
+
+void Chip8Server::WorkerThread(Chip8ServerShard& shard)
+{
+    std::vector<Chip8ServerCommand> commands;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.commands_available.wait(lock, [&shard]
+            {
+                return !shard.commands.empty() || shard.stopping;
+            });
+
+            if (shard.stopping)
+            {
+                return;
+            }
+
+            // Everything that arrived while the previous batch ran becomes the next batch
+            commands.swap(shard.commands);
+        }
+
+        ExecuteBatch(shard, commands);
+        commands.clear();
+    }
+}
+
+void Chip8Server::ExecuteBatch(Chip8ServerShard& shard, const std::vector<Chip8ServerCommand>& commands)
+{
+    Chip8ServerReplies replies;
+    std::unordered_map<uint32_t, Chip8ServerPendingSteps> pending_steps;
+
+    for (auto& command: commands)
+    {
+        uint32_t session_id = command.header.session;
+        auto pending = pending_steps.find(session_id);
+
+        if (command.header.type == Chip8ServerMessageType::Step && command.status == Chip8ServerStatus::Ok)
+        {
+            Chip8ServerStepRequest request{};
+            std::memcpy(&request, command.payload.data(), sizeof(request));
+
+            auto& steps = pending_steps[session_id];
+            steps.session = session_id;
+            steps.frames += request.frames;
+            steps.requests.push_back(command.header);
+
+            continue;
+        }
+
+        // Anything else, keys especially, has to see the steps sent before it
+        if (pending != pending_steps.end())
+        {
+            RunSteps(shard, pending->second, replies);
+            pending_steps.erase(pending);
+        }
+
+        if (command.status != Chip8ServerStatus::Ok)
+        {
+            Chip8ServerMessageHeader reply = command.header;
+            reply.status = command.status;
+
+            AppendServerMessage(replies[command.connection], reply, nullptr, 0);
+            continue;
+        }
+
+        ExecuteCommand(shard, command, replies);
+    }
+
+    for (auto& [session_id, steps]: pending_steps)
+    {
+        RunSteps(shard, steps, replies);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_replies_mutex);
+
+        for (auto& [connection_id, bytes]: replies)
+        {
+            auto& queued = _replies[connection_id];
+            queued.insert(queued.end(), bytes.begin(), bytes.end());
+        }
+    }
+
+    uint64_t value = 1;
+    if (write(_wake_fd, &value, sizeof(value)) < 0)
+    {
+        // Full counter, the I/O thread is woken up anyway
+    }
+}
+
+void Chip8Server::ExecuteCommand(Chip8ServerShard& shard, const Chip8ServerCommand& command,
+                                 Chip8ServerReplies& replies)
+{
+    auto& output = replies[command.connection];
+    Chip8ServerMessageHeader reply = command.header;
+    reply.status = Chip8ServerStatus::Ok;
+
+    if (command.header.type == Chip8ServerMessageType::CreateSession)
+    {
+        Chip8ServerCreateRequest request{};
+        std::memcpy(&request, command.payload.data(), sizeof(request));
+
+        auto& session = shard.sessions[command.header.session];
+        session.connection = command.connection;
+        session.variant = static_cast<Chip8Variant>(request.variant);
+        session.clock_speed = std::min(request.clock_speed, C8_SERVER_MAX_CLOCK_SPEED);
+        session.seed = request.seed;
+        session.interpreter = std::make_unique<Chip8Interpreter>(session.variant);
+        session.interpreter->SeedRandom(session.seed);
+
+        AppendServerMessage(output, reply, nullptr, 0);
+        return;
+    }
+
+    auto found = shard.sessions.find(command.header.session);
+    if (found == shard.sessions.end())
+    {
+        reply.status = Chip8ServerStatus::UnknownSession;
+        AppendServerMessage(output, reply, nullptr, 0);
+        return;
+    }
+
+    auto& session = found->second;
+
+    try
+    {
+        switch (command.header.type)
+        {
+            case Chip8ServerMessageType::DestroySession:
+                shard.sessions.erase(found);
+                AppendServerMessage(output, reply, nullptr, 0);
+                break;
+            case Chip8ServerMessageType::LoadRom:
+                // Delta base stays, it's still what the client shows
+                session.interpreter = std::make_unique<Chip8Interpreter>(session.variant);
+                session.interpreter->SeedRandom(session.seed);
+                session.interpreter->LoadROM(command.payload.data(), command.payload.size());
+                AppendServerMessage(output, reply, nullptr, 0);
+                break;
+            case Chip8ServerMessageType::Key:
+                session.interpreter->HandleKeyEvent(
+                        command.payload[1] != 0 ? CalicoEvent::KeyDown : CalicoEvent::KeyUp,
+                        static_cast<CalicoKey>(command.payload[0]));
+                AppendServerMessage(output, reply, nullptr, 0);
+                break;
+            case Chip8ServerMessageType::FetchFrame:
+            {
+                std::vector<uint8_t> delta;
+                auto& frame_buffer = session.interpreter->AccessFrameBuffer();
+
+                AppendFrameDelta(delta, frame_buffer, session.sent_frame, true, session.frames,
+                                 session.interpreter->GetProgramCounter(), session.interpreter->ShouldPlaySound());
+                session.sent_frame = frame_buffer;
+
+                AppendServerMessage(output, reply, delta.data(), delta.size());
+                break;
+            }
+            default:
+                reply.status = Chip8ServerStatus::InvalidRequest;
+                AppendServerMessage(output, reply, nullptr, 0);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::string message = e.what();
+
+        reply.status = Chip8ServerStatus::ExecutionError;
+        AppendServerMessage(output, reply, message.data(), message.size());
+    }
+}
+
+void Chip8Server::RunSteps(Chip8ServerShard& shard, Chip8ServerPendingSteps& steps, Chip8ServerReplies& replies)
+{
+    auto found = shard.sessions.find(steps.session);
+    if (found == shard.sessions.end())
+    {
+        return;
+    }
+
+    auto& session = found->second;
+    auto& output = replies[session.connection];
+    Chip8Interpreter& interpreter = *session.interpreter;
+
+    try
+    {
+        for (auto frame = 0u; frame < steps.frames; frame++)
+        {
+            for (auto i = 0u; i < session.clock_speed / 60; i++)
+            {
+                interpreter.ExecuteNextInstruction();
+            }
+
+            interpreter.TickSoundTimer();
+            interpreter.TickDelayTimer();
+            session.frames++;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::string message = e.what();
+
+        for (auto request: steps.requests)
+        {
+            request.status = Chip8ServerStatus::ExecutionError;
+            AppendServerMessage(output, request, message.data(), message.size());
+        }
+
+        return;
+    }
+
+    // Every answer reports the state after the whole batch, only the first one has changes left to send
+    std::vector<uint8_t> delta;
+
+    for (auto request: steps.requests)
+    {
+        delta.clear();
+        AppendFrameDelta(delta, interpreter.AccessFrameBuffer(), session.sent_frame, false, session.frames,
+                         interpreter.GetProgramCounter(), interpreter.ShouldPlaySound());
+        session.sent_frame = interpreter.AccessFrameBuffer();
+
+        request.status = Chip8ServerStatus::Ok;
+        AppendServerMessage(output, request, delta.data(), delta.size());
+    }
+}
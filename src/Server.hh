@@ -0,0 +1,134 @@
+#ifndef CALICOC8_SERVER_HH
+#define CALICOC8_SERVER_HH
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Interpreter.hh"
+#include "ServerProtocol.hh"
+
+struct Chip8ServerSettings
+{
+    std::string socket_path;
+    unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t max_sessions = 4096;
+};
+
+// Request forwarded from the I/O thread to the shard owning its session
+struct Chip8ServerCommand
+{
+    uint64_t connection = 0;
+    Chip8ServerMessageHeader header{};
+    std::vector<uint8_t> payload;
+    // Set when the I/O thread rejected the request, the worker only answers it
+    Chip8ServerStatus status = Chip8ServerStatus::Ok;
+};
+
+// Only ever touched by the worker of its shard
+struct Chip8ServerSession
+{
+    uint64_t connection = 0;
+    Chip8Variant variant = Chip8Variant::Chip8;
+    uint32_t clock_speed = 600;
+    uint32_t seed = 0;
+    std::unique_ptr<Chip8Interpreter> interpreter;
+    uint64_t frames = 0;
+    // Base of the next delta, what the client has seen last
+    Chip8FrameBuffer sent_frame{};
+};
+
+// Consecutive steps of a session within a batch, run back to back and answered together
+struct Chip8ServerPendingSteps
+{
+    uint32_t session = 0;
+    uint32_t frames = 0;
+    std::vector<Chip8ServerMessageHeader> requests;
+};
+
+// Encoded answers by connection
+typedef std::unordered_map<uint64_t, std::vector<uint8_t>> Chip8ServerReplies;
+
+struct Chip8ServerShard
+{
+    std::mutex mutex;
+    std::condition_variable commands_available;
+    std::vector<Chip8ServerCommand> commands;
+    bool stopping = false;
+
+    std::unordered_map<uint32_t, Chip8ServerSession> sessions;
+    std::thread worker;
+};
+
+struct Chip8ServerConnection
+{
+    int fd = -1;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    size_t output_offset = 0;
+    // Registered with epoll, EPOLLIN is dropped while too many answers wait to be written
+    uint32_t events = 0;
+};
+
+// Hosts CHIP-8 sessions for clients of a local Unix domain socket. One thread does all socket I/O with epoll
+// and parses requests, sessions are sharded over worker threads by id and every worker runs the requests it
+// got since its last wake up as one batch. Answers go back through a queue the I/O thread is woken up for.
+class Chip8Server
+{
+public:
+    explicit Chip8Server(const Chip8ServerSettings& settings);
+    ~Chip8Server();
+
+    Chip8Server(const Chip8Server&) = delete;
+    Chip8Server& operator=(const Chip8Server&) = delete;
+
+    // Serves until Stop is called
+    void Run();
+
+    // Async signal safe
+    void Stop();
+
+private:
+    void AcceptConnections();
+    void CloseConnection(uint64_t connection_id);
+    void ReadConnection(uint64_t connection_id);
+    void WriteConnection(uint64_t connection_id);
+    void HandleRequest(uint64_t connection_id, const Chip8ServerMessageHeader& header, const uint8_t* payload);
+    void Reply(uint64_t connection_id, const Chip8ServerMessageHeader& request, Chip8ServerStatus status,
+               const std::string& message = "");
+    void FlushReplies();
+
+    void Forward(Chip8ServerCommand command);
+    void WorkerThread(Chip8ServerShard& shard);
+    void ExecuteBatch(Chip8ServerShard& shard, const std::vector<Chip8ServerCommand>& commands);
+    void ExecuteCommand(Chip8ServerShard& shard, const Chip8ServerCommand& command, Chip8ServerReplies& replies);
+    void RunSteps(Chip8ServerShard& shard, Chip8ServerPendingSteps& steps, Chip8ServerReplies& replies);
+
+    Chip8ServerSettings _settings;
+
+    int _listen_fd = -1;
+    int _epoll_fd = -1;
+    // Signalled by workers with new answers and by Stop
+    int _wake_fd = -1;
+    std::atomic<bool> _running{false};
+
+    std::vector<std::unique_ptr<Chip8ServerShard>> _shards;
+
+    // I/O thread only
+    std::unordered_map<uint64_t, Chip8ServerConnection> _connections;
+    std::unordered_map<uint32_t, uint64_t> _session_owners;
+    uint64_t _next_connection_id = 1;
+    uint32_t _next_session_id = 1;
+
+    // Filled by workers
+    std::mutex _replies_mutex;
+    Chip8ServerReplies _replies;
+};
+
+#endif //CALICOC8_SERVER_HH
@@ -0,0 +1,96 @@
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include "ServerProtocol.hh"
+
+bool Chip8ServerFrame::IsLit(int x, int y, int plane) const
+{
+    uint64_t word = words[(plane * C8_HIRES_RES_Y + y) * C8_ROW_WORDS + x / 64];
+
+    return ((word >> (63 - x % 64)) & 1) != 0;
+}
+
+void AppendServerMessage(std::vector<uint8_t>& buffer, Chip8ServerMessageHeader header, const void* payload,
+                         size_t size)
+{
+    header.size = static_cast<uint32_t>(size);
+
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(header) + size);
+
+    std::memcpy(buffer.data() + offset, &header, sizeof(header));
+    if (size > 0)
+    {
+        std::memcpy(buffer.data() + offset + sizeof(header), payload, size);
+    }
+}
+
+void AppendFrameDelta(std::vector<uint8_t>& buffer, const Chip8FrameBuffer& current,
+                      const Chip8FrameBuffer& previous, bool full, uint64_t frame, uint16_t pc, bool sound)
+{
+    uint8_t indices[C8_SERVER_FRAME_WORDS];
+    uint64_t words[C8_SERVER_FRAME_WORDS];
+    int changed_words = 0;
+
+    for (auto plane = 0; plane < C8_PLANE_COUNT; plane++)
+    {
+        const uint64_t* current_rows = current.GetPlaneRows(plane);
+        const uint64_t* previous_rows = previous.GetPlaneRows(plane);
+
+        for (auto word = 0; word < C8_HIRES_RES_Y * C8_ROW_WORDS; word++)
+        {
+            if (full || current_rows[word] != previous_rows[word])
+            {
+                indices[changed_words] = static_cast<uint8_t>(plane * C8_HIRES_RES_Y * C8_ROW_WORDS + word);
+                words[changed_words] = current_rows[word];
+                changed_words++;
+            }
+        }
+    }
+
+    Chip8ServerFrameDelta delta{};
+    delta.frame = frame;
+    delta.pc = pc;
+    delta.sound = sound;
+    delta.high_resolution = current.IsHighResolution();
+    delta.changed_words = changed_words;
+
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(delta) + changed_words * (1 + sizeof(uint64_t)));
+
+    uint8_t* output = buffer.data() + offset;
+    std::memcpy(output, &delta, sizeof(delta));
+    std::memcpy(output + sizeof(delta), indices, changed_words);
+    std::memcpy(output + sizeof(delta) + changed_words, words, changed_words * sizeof(uint64_t));
+}
+
+void ApplyFrameDelta(Chip8ServerFrame& frame, const uint8_t* payload, size_t size)
+{
+    Chip8ServerFrameDelta delta{};
+
+    if (size < sizeof(delta))
+    {
+        throw std::runtime_error("Truncated frame delta");
+    }
+
+    std::memcpy(&delta, payload, sizeof(delta));
+
+    if (delta.changed_words > C8_SERVER_FRAME_WORDS ||
+        size != sizeof(delta) + delta.changed_words * (1 + sizeof(uint64_t)))
+    {
+        throw std::runtime_error("Invalid frame delta size");
+    }
+
+    const uint8_t* indices = payload + sizeof(delta);
+    const uint8_t* words = indices + delta.changed_words;
+
+    for (auto i = 0; i < delta.changed_words; i++)
+    {
+        std::memcpy(&frame.words[indices[i]], words + i * sizeof(uint64_t), sizeof(uint64_t));
+    }
+
+    frame.high_resolution = delta.high_resolution != 0;
+    frame.frame = delta.frame;
+    frame.pc = delta.pc;
+    frame.sound = delta.sound != 0;
+}
@@ -0,0 +1,118 @@
+#ifndef CALICOC8_SERVERPROTOCOL_HH
+#define CALICOC8_SERVERPROTOCOL_HH
+
+#include <cstdint>
+#include <array>
+#include <string>
+#include <vector>
+#include "FrameBuffer.hh"
+
+// Messages are a header followed by size bytes of payload in native byte order, both ends share the machine.
+// Every request is answered with a message of the same type, tag and session, in the order the requests of a
+// session were sent.
+constexpr uint32_t C8_SERVER_MAX_PAYLOAD = 64 * 1024;
+// Steps are run on the worker owning the session, long ones would hold up the other sessions of its shard
+constexpr uint32_t C8_SERVER_MAX_STEP_FRAMES = 600;
+// Faster sessions are clamped to it, one step frame runs clock_speed / 60 instructions
+constexpr uint32_t C8_SERVER_MAX_CLOCK_SPEED = 60000;
+
+// Word index of the packed frame buffer fits into a byte, see Chip8FrameBuffer
+constexpr int C8_SERVER_FRAME_WORDS = C8_PLANE_COUNT * C8_HIRES_RES_Y * C8_ROW_WORDS;
+static_assert(C8_SERVER_FRAME_WORDS <= 256, "Frame words are indexed with a byte");
+
+enum class Chip8ServerMessageType : uint8_t
+{
+    // Chip8ServerCreateRequest, answered with the id of the new session
+    CreateSession = 1,
+    DestroySession,
+    // ROM bytes, resets the machine first
+    LoadRom,
+    // Chip8ServerKeyRequest
+    Key,
+    // Chip8ServerStepRequest, answered with a frame delta against the last frame sent for the session
+    Step,
+    // Answered with a delta containing every word, which also resets the base of later deltas
+    FetchFrame
+};
+
+enum class Chip8ServerStatus : uint8_t
+{
+    Ok,
+    InvalidRequest,
+    UnknownSession,
+    TooManySessions,
+    // Payload of the answer is the error message
+    ExecutionError
+};
+
+struct Chip8ServerMessageHeader
+{
+    // Payload bytes following the header
+    uint32_t size;
+    Chip8ServerMessageType type;
+    // Answers only
+    Chip8ServerStatus status;
+    uint16_t reserved;
+    uint32_t session;
+    // Echoed in the answer so clients can pipeline requests
+    uint32_t tag;
+};
+
+struct Chip8ServerCreateRequest
+{
+    uint8_t variant;
+    uint8_t reserved[3];
+    uint32_t clock_speed;
+    uint32_t seed;
+};
+
+struct Chip8ServerKeyRequest
+{
+    uint8_t key;
+    uint8_t pressed;
+};
+
+struct Chip8ServerStepRequest
+{
+    uint32_t frames;
+};
+
+// Followed by changed_words word indices (one byte each) and then the changed_words new 64 bit words
+struct Chip8ServerFrameDelta
+{
+    // Frames run since the session was created
+    uint64_t frame;
+    uint16_t pc;
+    uint8_t sound;
+    uint8_t high_resolution;
+    uint16_t changed_words;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(Chip8ServerMessageHeader) == 16 && sizeof(Chip8ServerCreateRequest) == 12 &&
+              sizeof(Chip8ServerFrameDelta) == 16, "Protocol structures can't have padding");
+
+// Client side copy of a session's screen, kept up to date by applying deltas
+struct Chip8ServerFrame
+{
+    std::array<uint64_t, C8_SERVER_FRAME_WORDS> words{0};
+    bool high_resolution = false;
+    uint64_t frame = 0;
+    uint16_t pc = 0;
+    bool sound = false;
+
+    // Same indexing as Chip8FrameBuffer::GetPlaneRows
+    bool IsLit(int x, int y, int plane = 0) const;
+};
+
+void AppendServerMessage(std::vector<uint8_t>& buffer, Chip8ServerMessageHeader header, const void* payload,
+                         size_t size);
+
+// Appends the words of current differing from previous, all of them when full is set
+void AppendFrameDelta(std::vector<uint8_t>& buffer, const Chip8FrameBuffer& current,
+                      const Chip8FrameBuffer& previous, bool full, uint64_t frame, uint16_t pc, bool sound);
+
+// Throws when the payload isn't a well formed delta
+void ApplyFrameDelta(Chip8ServerFrame& frame, const uint8_t* payload, size_t size);
+
+#endif //CALICOC8_SERVERPROTOCOL_HH
@@ -0,0 +1,202 @@
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SharedFrames.hh"
+
+static std::string GetSharedMemoryName(const std::string& name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+// Unlinks the object only when it's a frame ring whose publisher no longer runs
+static bool RemoveAbandonedObject(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        // Removed in the meantime, creating it can be tried again
+        return errno == ENOENT;
+    }
+
+    struct stat status{};
+    bool abandoned = false;
+
+    if (fstat(fd, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(Chip8SharedFramesHeader)))
+    {
+        void* mapping = mmap(nullptr, sizeof(Chip8SharedFramesHeader), PROT_READ, MAP_SHARED, fd, 0);
+
+        if (mapping != MAP_FAILED)
+        {
+            auto* header = static_cast<const Chip8SharedFramesHeader*>(mapping);
+
+            abandoned = header->magic.load(std::memory_order_acquire) == C8_SHARED_FRAMES_MAGIC &&
+                        header->version == C8_SHARED_FRAMES_VERSION && header->publisher_pid > 0 &&
+                        kill(header->publisher_pid, 0) != 0 && errno == ESRCH;
+
+            munmap(mapping, sizeof(Chip8SharedFramesHeader));
+        }
+    }
+
+    close(fd);
+
+    if (abandoned)
+    {
+        shm_unlink(name.c_str());
+    }
+
+    return abandoned;
+}
+
+Chip8SharedFramePublisher::Chip8SharedFramePublisher(const std::string& name)
+        : _name(GetSharedMemoryName(name))
+{
+    // Never reuses an existing object, resizing it under its readers and publisher would crash them
+    int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST && RemoveAbandonedObject(_name))
+    {
+        fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+
+    if (fd < 0)
+    {
+        int error = errno;
+
+        throw std::runtime_error("Unable to create shared memory " + _name + ": " + strerror(error) +
+                                 (error == EEXIST ? " (in use by another instance or not a frame ring of this"
+                                                    " version, remove /dev/shm" + _name + " if it's stale)" : ""));
+    }
+
+    if (ftruncate(fd, sizeof(Chip8SharedFrames)) != 0)
+    {
+        close(fd);
+        shm_unlink(_name.c_str());
+
+        throw std::runtime_error("Unable to resize shared memory " + _name);
+    }
+
+    void* mapping = mmap(nullptr, sizeof(Chip8SharedFrames), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(_name.c_str());
+
+        throw std::runtime_error("Unable to map shared memory " + _name);
+    }
+
+    // Zero filled memory is a valid object representation of every field, atomics included
+    _frames = static_cast<Chip8SharedFrames*>(mapping);
+    _frames->header.version = C8_SHARED_FRAMES_VERSION;
+    _frames->header.slot_count = C8_SHARED_FRAMES_SLOT_COUNT;
+    _frames->header.width = C8_HIRES_RES_X;
+    _frames->header.height = C8_HIRES_RES_Y;
+    _frames->header.publisher_pid = getpid();
+    _frames->header.magic.store(C8_SHARED_FRAMES_MAGIC, std::memory_order_release);
+}
+
+Chip8SharedFramePublisher::~Chip8SharedFramePublisher()
+{
+    munmap(_frames, sizeof(Chip8SharedFrames));
+    shm_unlink(_name.c_str());
+}
+
+void Chip8SharedFramePublisher::Publish(const Chip8FrameBuffer& frame_buffer, uint16_t pc, uint16_t i,
+                                        uint8_t delay, uint8_t sound)
+{
+    auto& slot = _frames->slots[_published_frames % C8_SHARED_FRAMES_SLOT_COUNT];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.frame = _published_frames;
+    slot.pc = pc;
+    slot.i = i;
+    slot.delay = delay;
+    slot.sound = sound;
+    slot.width = frame_buffer.GetWidth();
+    slot.height = frame_buffer.GetHeight();
+    frame_buffer.RenderRGBA(reinterpret_cast<uint32_t*>(slot.pixels));
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    _published_frames++;
+    _frames->header.published_frames.store(_published_frames, std::memory_order_release);
+}
+
+Chip8SharedFrameReader::Chip8SharedFrameReader(const std::string& name)
+{
+    std::string shared_memory_name = GetSharedMemoryName(name);
+
+    int fd = shm_open(shared_memory_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to open shared memory " + shared_memory_name + ": " + strerror(errno));
+    }
+
+    // Mapping past the end of a smaller object would fault on first access instead of failing here
+    struct stat status{};
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Chip8SharedFrames)))
+    {
+        close(fd);
+
+        throw std::runtime_error("Shared memory " + shared_memory_name + " is not a CalicoC8 frame ring");
+    }
+
+    void* mapping = mmap(nullptr, sizeof(Chip8SharedFrames), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map shared memory " + shared_memory_name);
+    }
+
+    _frames = static_cast<const Chip8SharedFrames*>(mapping);
+
+    if (_frames->header.magic.load(std::memory_order_acquire) != C8_SHARED_FRAMES_MAGIC ||
+        _frames->header.version != C8_SHARED_FRAMES_VERSION ||
+        _frames->header.slot_count != C8_SHARED_FRAMES_SLOT_COUNT)
+    {
+        munmap(const_cast<Chip8SharedFrames*>(_frames), sizeof(Chip8SharedFrames));
+
+        throw std::runtime_error("Shared memory " + shared_memory_name + " is not a CalicoC8 frame ring");
+    }
+}
+
+Chip8SharedFrameReader::~Chip8SharedFrameReader()
+{
+    munmap(const_cast<Chip8SharedFrames*>(_frames), sizeof(Chip8SharedFrames));
+}
+
+uint64_t Chip8SharedFrameReader::GetPublishedFrameCount() const
+{
+    return _frames->header.published_frames.load(std::memory_order_acquire);
+}
+
+bool Chip8SharedFrameReader::ReadLatest(const std::function<void(const Chip8SharedFrameSlot&)>& consumer) const
+{
+    uint64_t published_frames = GetPublishedFrameCount();
+    if (published_frames == 0)
+    {
+        return false;
+    }
+
+    auto& slot = _frames->slots[(published_frames - 1) % C8_SHARED_FRAMES_SLOT_COUNT];
+
+    uint32_t sequence_before = slot.sequence.load(std::memory_order_acquire);
+    if ((sequence_before & 1) != 0)
+    {
+        return false;
+    }
+
+    consumer(slot);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return slot.sequence.load(std::memory_order_relaxed) == sequence_before;
+}
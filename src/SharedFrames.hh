@@ -0,0 +1,102 @@
+#ifndef CALICOC8_SHAREDFRAMES_HH
+#define CALICOC8_SHAREDFRAMES_HH
+
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <string>
+#include "FrameBuffer.hh"
+
+constexpr uint32_t C8_SHARED_FRAMES_MAGIC = 0x46533843; // "C8SF"
+constexpr uint32_t C8_SHARED_FRAMES_VERSION = 3;
+
+// Writer only comes back to a slot every this many frames, so readers rarely see it being rewritten
+constexpr uint32_t C8_SHARED_FRAMES_SLOT_COUNT = 4;
+
+// Sequence is odd while the emulator writes the slot, readers copy or use the data in place and accept it only
+// when the sequence was even and unchanged before and after
+struct alignas(64) Chip8SharedFrameSlot
+{
+    std::atomic<uint32_t> sequence;
+
+    uint64_t frame;
+    uint16_t pc;
+    uint16_t i;
+    uint8_t delay;
+    uint8_t sound;
+
+    // Resolution of this frame, SUPER-CHIP games can switch it at any time
+    uint16_t width;
+    uint16_t height;
+
+    // RGBA rows of width pixels as written by Chip8FrameBuffer::RenderRGBA, can be uploaded to textures as is
+    alignas(64) uint8_t pixels[C8_HIRES_RES_X * C8_HIRES_RES_Y * sizeof(uint32_t)];
+};
+
+struct alignas(64) Chip8SharedFramesHeader
+{
+    // Written last when publishing starts, readers need to wait for it
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slot_count;
+    // Largest resolution a slot can hold
+    uint16_t width;
+    uint16_t height;
+    // Lets a new publisher tell an object left behind by a crash from one still in use
+    int32_t publisher_pid;
+
+    // Number of published frames, newest one is in slot (published_frames - 1) % slot_count
+    std::atomic<uint64_t> published_frames;
+};
+
+// Whole shared memory object, same layout in every process
+struct Chip8SharedFrames
+{
+    Chip8SharedFramesHeader header;
+    Chip8SharedFrameSlot slots[C8_SHARED_FRAMES_SLOT_COUNT];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "Shared frame ring needs address free atomics");
+
+// Owns the POSIX shared memory object, it's unlinked again when the publisher is destroyed
+class Chip8SharedFramePublisher
+{
+public:
+    // Name as for shm_open, leading slash is added when missing
+    explicit Chip8SharedFramePublisher(const std::string& name);
+    ~Chip8SharedFramePublisher();
+
+    Chip8SharedFramePublisher(const Chip8SharedFramePublisher&) = delete;
+    Chip8SharedFramePublisher& operator=(const Chip8SharedFramePublisher&) = delete;
+
+    // Never waits for readers
+    void Publish(const Chip8FrameBuffer& frame_buffer, uint16_t pc, uint16_t i, uint8_t delay, uint8_t sound);
+
+private:
+    std::string _name;
+    Chip8SharedFrames* _frames = nullptr;
+    uint64_t _published_frames = 0;
+};
+
+class Chip8SharedFrameReader
+{
+public:
+    // Throws when nothing is published under the name
+    explicit Chip8SharedFrameReader(const std::string& name);
+    ~Chip8SharedFrameReader();
+
+    Chip8SharedFrameReader(const Chip8SharedFrameReader&) = delete;
+    Chip8SharedFrameReader& operator=(const Chip8SharedFrameReader&) = delete;
+
+    uint64_t GetPublishedFrameCount() const;
+
+    // Hands the newest slot to consumer without copying, returns false when it was overwritten meanwhile
+    // and whatever consumer saw has to be thrown away
+    bool ReadLatest(const std::function<void(const Chip8SharedFrameSlot&)>& consumer) const;
+
+private:
+    const Chip8SharedFrames* _frames = nullptr;
+};
+
+#endif //CALICOC8_SHAREDFRAMES_HH
@@ -0,0 +1,736 @@
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "Trace.hh"
+
+static constexpr std::array<uint8_t, 8> C8_TRACE_MAGIC{'C', '8', 'T', 'R', 0x01, 0x00, 0x00, 0x00};
+
+// Record tags, delta records always have the highest bit set and use the rest as flags
+constexpr uint8_t TRACE_TAG_KEYFRAME = 0x4B;
+constexpr uint8_t TRACE_TAG_DELTA = 0x80;
+constexpr uint8_t TRACE_FLAG_PC_JUMP = 0x01;
+constexpr uint8_t TRACE_FLAG_REGISTERS = 0x02;
+constexpr uint8_t TRACE_FLAG_INDEX = 0x04;
+constexpr uint8_t TRACE_FLAG_TIMERS = 0x08;
+constexpr uint8_t TRACE_FLAG_WRITE = 0x10;
+
+static std::string GetSegmentPath(const std::string& path, uint32_t number)
+{
+    return path + "." + std::to_string(number);
+}
+
+static uint8_t* PutVarint(uint8_t* cursor, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *cursor++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+
+    *cursor++ = value;
+
+    return cursor;
+}
+
+static uint8_t* PutSignedVarint(uint8_t* cursor, int32_t value)
+{
+    // ZigZag encoding, so small negative values stay short
+    return PutVarint(cursor, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+}
+
+static uint8_t* PutU16(uint8_t* cursor, uint16_t value)
+{
+    *cursor++ = value & 0xFF;
+    *cursor++ = value >> 8;
+
+    return cursor;
+}
+
+Chip8TraceWriter::Chip8TraceWriter(const std::string& path, const Chip8TraceStep& initial, size_t segment_size)
+        : _path(path), _segment_size(segment_size), _step(initial), _last(initial)
+{
+    if (_segment_size < C8_TRACE_MAGIC.size() + C8_TRACE_MAX_RECORD_SIZE * 2)
+    {
+        throw std::invalid_argument("Trace segment size too small: " + std::to_string(segment_size));
+    }
+
+    // First segment is mapped here so an unusable path is reported right away
+    _current = MapSegment(0);
+    _cursor = _current.data + _current.used;
+    _rotate_threshold = _current.data + _segment_size - C8_TRACE_MAX_RECORD_SIZE;
+
+    try
+    {
+        _raw_region = MapRawRegion();
+    }
+    catch (const std::exception& e)
+    {
+        UnmapSegment(_current);
+        throw;
+    }
+
+    for (size_t chunk = C8_TRACE_MAX_RAW_CHUNKS; chunk-- > 0;)
+    {
+        _free_chunks.push_back(_raw_region + chunk * C8_TRACE_RAW_CHUNK_SIZE);
+    }
+
+    SwitchRawChunk();
+
+    _encoder_thread = std::thread(&Chip8TraceWriter::EncoderLoop, this);
+}
+
+Chip8TraceWriter::~Chip8TraceWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_raw_chunk.data != nullptr)
+        {
+            _raw_chunk.used = _raw_cursor - _raw_chunk.data;
+            _filled_chunks.push_back(_raw_chunk);
+        }
+
+        _stopping = true;
+    }
+
+    _condition.notify_all();
+    _encoder_thread.join();
+
+    munmap(_raw_region, C8_TRACE_MAX_RAW_CHUNKS * C8_TRACE_RAW_CHUNK_SIZE);
+}
+
+uint8_t* Chip8TraceWriter::MapRawRegion()
+{
+    // Over-mapped to start on a huge page boundary, so a chunk is only a couple of faults
+    size_t region_size = C8_TRACE_MAX_RAW_CHUNKS * C8_TRACE_RAW_CHUNK_SIZE;
+    size_t mapped_size = region_size + C8_TRACE_HUGE_PAGE_SIZE;
+    void* mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map trace buffer");
+    }
+
+    auto start = reinterpret_cast<uintptr_t>(mapping);
+    auto aligned = (start + C8_TRACE_HUGE_PAGE_SIZE - 1) & ~(C8_TRACE_HUGE_PAGE_SIZE - 1);
+    if (aligned > start)
+    {
+        munmap(mapping, aligned - start);
+    }
+    if (aligned + region_size < start + mapped_size)
+    {
+        munmap(reinterpret_cast<void*>(aligned + region_size), start + mapped_size - aligned - region_size);
+    }
+
+    auto* data = reinterpret_cast<uint8_t*>(aligned);
+#if defined(MADV_HUGEPAGE)
+    madvise(data, region_size, MADV_HUGEPAGE);
+#endif
+
+    // Touching is much cheaper than MAP_POPULATE and also works without huge pages
+    auto* bytes = reinterpret_cast<volatile uint8_t*>(data);
+    for (size_t offset = 0; offset < region_size; offset += 4096)
+    {
+        bytes[offset] = 0;
+    }
+
+    return data;
+}
+
+void Chip8TraceWriter::SwitchRawChunk()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_raw_chunk.data != nullptr)
+    {
+        _raw_chunk.used = _raw_cursor - _raw_chunk.data;
+        _filled_chunks.push_back(_raw_chunk);
+        _condition.notify_all();
+    }
+
+    // Nothing is written anywhere until a new chunk is in place, in case this throws
+    _raw_chunk = RawChunk{};
+    _raw_cursor = nullptr;
+    _raw_end = nullptr;
+
+    // Emulation got too far ahead of the encoder
+    _condition.wait(lock, [this] { return !_free_chunks.empty() || !_encoder_error.empty(); });
+
+    if (!_encoder_error.empty())
+    {
+        throw std::runtime_error(_encoder_error);
+    }
+
+    uint8_t* data = _free_chunks.back();
+    _free_chunks.pop_back();
+
+    _raw_chunk.data = data;
+    _raw_cursor = data;
+    _raw_end = data + C8_TRACE_RAW_CHUNK_SIZE;
+}
+
+void Chip8TraceWriter::EncoderLoop()
+{
+#if defined(__linux__)
+    // Encoding catches up whenever the emulation thread leaves a core idle, on a single core it would otherwise
+    // take turns with emulation. Raw chunks buffer what wasn't encoded yet, up to C8_TRACE_MAX_RAW_CHUNKS.
+    sched_param parameters{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &parameters);
+#endif
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this] { return _stopping || !_filled_chunks.empty(); });
+
+        while (!_filled_chunks.empty())
+        {
+            RawChunk chunk = _filled_chunks.front();
+            _filled_chunks.pop_front();
+
+            // After an error chunks are only recycled, so the emulation thread never waits for good
+            if (_encoder_error.empty())
+            {
+                lock.unlock();
+
+                try
+                {
+                    EncodeChunk(chunk);
+                    lock.lock();
+                }
+                catch (const std::exception& e)
+                {
+                    lock.lock();
+                    _encoder_error = e.what();
+                }
+            }
+
+            _free_chunks.push_back(chunk.data);
+            _condition.notify_all();
+        }
+
+        if (_stopping)
+        {
+            break;
+        }
+    }
+
+    lock.unlock();
+
+    if (_current.data != nullptr)
+    {
+        _current.used = _cursor - _current.data;
+        UnmapSegment(_current);
+    }
+}
+
+void Chip8TraceWriter::Resynchronize(const Chip8TraceStep& state)
+{
+    uint8_t flags = C8_TRACE_RAW_I | C8_TRACE_RAW_LOW_REGISTERS | C8_TRACE_RAW_HIGH_REGISTERS |
+                    C8_TRACE_RAW_STATE_ONLY;
+    Chip8TraceRawRecord record{state.pc, 0xF000, state.general[0], flags, state.delay, state.sound};
+    uint64_t i = state.i;
+
+    uint8_t* output = Reserve(GetRawRecordSize(flags));
+    StoreRawSlot(output, &record);
+    StoreRawSlot(output + C8_TRACE_RAW_SLOT_SIZE, &i);
+    StoreRawSlot(output + 2 * C8_TRACE_RAW_SLOT_SIZE, state.general.data());
+    StoreRawSlot(output + 3 * C8_TRACE_RAW_SLOT_SIZE, state.general.data() + C8_TRACE_RAW_SLOT_SIZE);
+}
+
+void Chip8TraceWriter::EncodeChunk(const RawChunk& chunk)
+{
+    const uint8_t* cursor = chunk.data;
+    const uint8_t* end = chunk.data + chunk.used;
+
+    while (cursor < end)
+    {
+        Chip8TraceRawRecord record;
+        memcpy(&record, cursor, sizeof(record));
+        cursor += sizeof(record);
+
+        uint8_t flags = 0;
+
+        _step.pc = record.pc;
+        _step.opcode = record.opcode;
+        _step.general[(record.opcode >> 8) & 0xF] = record.vx;
+        _step.delay = record.delay;
+        _step.sound = record.sound;
+        _step.write_address = 0;
+        _step.write_length = 0;
+
+        if (HasTraceFlags(record.opcode))
+        {
+            flags = record.vf_or_flags;
+        }
+        else
+        {
+            _step.general[0xF] = record.vf_or_flags;
+        }
+
+        if ((record.opcode & 0xF000) == 0xA000)
+        {
+            _step.i = record.opcode & 0x0FFF;
+        }
+
+        if ((flags & C8_TRACE_RAW_I) != 0)
+        {
+            uint64_t i;
+            memcpy(&i, cursor, sizeof(i));
+            _step.i = static_cast<uint16_t>(i);
+            cursor += C8_TRACE_RAW_SLOT_SIZE;
+        }
+
+        if ((flags & C8_TRACE_RAW_LOW_REGISTERS) != 0)
+        {
+            memcpy(_step.general.data(), cursor, C8_TRACE_RAW_SLOT_SIZE);
+            cursor += C8_TRACE_RAW_SLOT_SIZE;
+        }
+
+        if ((flags & C8_TRACE_RAW_HIGH_REGISTERS) != 0)
+        {
+            memcpy(_step.general.data() + C8_TRACE_RAW_SLOT_SIZE, cursor, C8_TRACE_RAW_SLOT_SIZE);
+            cursor += C8_TRACE_RAW_SLOT_SIZE;
+        }
+
+        if ((flags & C8_TRACE_RAW_STATE_ONLY) != 0)
+        {
+            continue;
+        }
+
+        if ((flags & C8_TRACE_RAW_WRITE) != 0)
+        {
+            RebuildWrittenBytes();
+        }
+
+        _step.index++;
+        EncodeStep();
+    }
+}
+
+void Chip8TraceWriter::RebuildWrittenBytes()
+{
+    int x = (_step.opcode >> 8) & 0xF;
+    int y = (_step.opcode >> 4) & 0xF;
+
+    _step.write_address = _step.i;
+
+    if ((_step.opcode & 0xF0FF) == 0xF033)
+    {
+        _step.write_length = 3;
+        _step.written[0] = _step.general[x] / 100;
+        _step.written[1] = (_step.general[x] / 10) % 10;
+        _step.written[2] = _step.general[x] % 10;
+    }
+    else if ((_step.opcode & 0xF0FF) == 0xF055)
+    {
+        _step.write_length = x + 1;
+        std::copy_n(_step.general.begin(), _step.write_length, _step.written.begin());
+    }
+    else
+    {
+        // XO-CHIP 5xy2 stores Vx to Vy in either direction
+        int step = x <= y ? 1 : -1;
+        _step.write_length = std::abs(x - y) + 1;
+
+        for (int offset = 0; offset < _step.write_length; offset++)
+        {
+            _step.written[offset] = _step.general[x + offset * step];
+        }
+    }
+}
+
+void Chip8TraceWriter::EncodeStep()
+{
+    if (_cursor >= _rotate_threshold)
+    {
+        RotateSegment();
+    }
+
+    if (_needs_keyframe)
+    {
+        WriteKeyframe(_step);
+        _needs_keyframe = false;
+    }
+    else
+    {
+        WriteDelta(_step);
+    }
+
+    _last.index = _step.index;
+    _last.pc = _step.pc;
+    _last.general = _step.general;
+    _last.i = _step.i;
+    _last.delay = _step.delay;
+    _last.sound = _step.sound;
+}
+
+void Chip8TraceWriter::WriteKeyframe(const Chip8TraceStep& step)
+{
+    uint8_t* cursor = _cursor;
+
+    *cursor++ = TRACE_TAG_KEYFRAME;
+    cursor = PutVarint(cursor, step.index);
+    cursor = PutU16(cursor, step.pc);
+    cursor = PutU16(cursor, step.opcode);
+    memcpy(cursor, step.general.data(), step.general.size());
+    cursor += step.general.size();
+    cursor = PutU16(cursor, step.i);
+    *cursor++ = step.delay;
+    *cursor++ = step.sound;
+    *cursor++ = step.write_length;
+
+    if (step.write_length != 0)
+    {
+        cursor = PutU16(cursor, step.write_address);
+        memcpy(cursor, step.written.data(), step.write_length);
+        cursor += step.write_length;
+    }
+
+    _cursor = cursor;
+}
+
+// Bit per register that differs between the two register files
+static uint16_t GetChangedRegistersMask(const std::array<uint8_t, 16>& a, const std::array<uint8_t, 16>& b)
+{
+#if defined(__SSE2__)
+    __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data())),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data())));
+
+    return ~_mm_movemask_epi8(equal) & 0xFFFF;
+#else
+    uint16_t mask = 0;
+    for (auto i = 0; i < 16; i++)
+    {
+        mask |= (a[i] != b[i]) << i;
+    }
+
+    return mask;
+#endif
+}
+
+void Chip8TraceWriter::WriteDelta(const Chip8TraceStep& step)
+{
+    // Everything is read into locals first, stores through the byte cursor would otherwise force reloads
+    const uint16_t expected_pc = _last.pc + 2;
+    const uint16_t changed_registers = GetChangedRegistersMask(step.general, _last.general);
+    const bool index_changed = step.i != _last.i;
+    const bool timers_changed = step.delay != _last.delay || step.sound != _last.sound;
+    const int32_t index_delta = step.i - _last.i;
+
+    uint8_t flags = TRACE_TAG_DELTA;
+    uint8_t* cursor = PutU16(_cursor + 1, step.opcode);
+
+    if (step.pc != expected_pc)
+    {
+        flags |= TRACE_FLAG_PC_JUMP;
+        cursor = PutSignedVarint(cursor, step.pc - expected_pc);
+    }
+
+    if (changed_registers != 0)
+    {
+        flags |= TRACE_FLAG_REGISTERS;
+        cursor = PutU16(cursor, changed_registers);
+
+        for (uint32_t remaining = changed_registers; remaining != 0; remaining &= remaining - 1)
+        {
+            *cursor++ = step.general[__builtin_ctz(remaining)];
+        }
+    }
+
+    if (index_changed)
+    {
+        flags |= TRACE_FLAG_INDEX;
+        cursor = PutSignedVarint(cursor, index_delta);
+    }
+
+    if (timers_changed)
+    {
+        flags |= TRACE_FLAG_TIMERS;
+        *cursor++ = step.delay;
+        *cursor++ = step.sound;
+    }
+
+    if (step.write_length != 0)
+    {
+        flags |= TRACE_FLAG_WRITE;
+        cursor = PutU16(cursor, step.write_address);
+        *cursor++ = step.write_length;
+        memcpy(cursor, step.written.data(), step.write_length);
+        cursor += step.write_length;
+    }
+
+    *_cursor = flags;
+    _cursor = cursor;
+}
+
+void Chip8TraceWriter::RotateSegment()
+{
+    uint32_t number = _current.number + 1;
+
+    _current.used = _cursor - _current.data;
+    UnmapSegment(_current);
+    _current = Segment{};
+
+    _current = MapSegment(number);
+    _cursor = _current.data + _current.used;
+    _rotate_threshold = _current.data + _segment_size - C8_TRACE_MAX_RECORD_SIZE;
+    _needs_keyframe = true;
+}
+
+Chip8TraceWriter::Segment Chip8TraceWriter::MapSegment(uint32_t number)
+{
+    std::string segment_path = GetSegmentPath(_path, number);
+
+    int fd = open(segment_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Unable to create trace segment: " + segment_path);
+    }
+
+    // Reserve blocks up front so the emulation thread never waits on file system allocation
+    if (posix_fallocate(fd, 0, _segment_size) != 0 && ftruncate(fd, _segment_size) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to resize trace segment: " + segment_path);
+    }
+
+    void* data = mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to map trace segment: " + segment_path);
+    }
+
+    // Take every write fault in one pass before encoding into it, MAP_POPULATE maps shared pages read only
+    auto* bytes = static_cast<volatile uint8_t*>(data);
+    for (size_t offset = 0; offset < _segment_size; offset += 4096)
+    {
+        bytes[offset] = 0x00;
+    }
+
+    memcpy(data, C8_TRACE_MAGIC.data(), C8_TRACE_MAGIC.size());
+
+    return {number, fd, static_cast<uint8_t*>(data), C8_TRACE_MAGIC.size()};
+}
+
+void Chip8TraceWriter::UnmapSegment(const Chip8TraceWriter::Segment& segment)
+{
+    munmap(segment.data, _segment_size);
+
+    // Drop unused tail, if that fails readers still stop at the zero filled remainder
+    ftruncate(segment.fd, segment.used);
+    close(segment.fd);
+}
+
+Chip8TraceReader::Chip8TraceReader(const std::string& path)
+        : _path(path)
+{
+    if (!OpenSegment(0))
+    {
+        throw std::invalid_argument("Invalid trace path: " + path);
+    }
+}
+
+Chip8TraceReader::~Chip8TraceReader()
+{
+    CloseSegment();
+}
+
+bool Chip8TraceReader::OpenSegment(uint32_t number)
+{
+    int fd = open(GetSegmentPath(_path, number).c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(C8_TRACE_MAGIC.size()))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid trace segment: " + GetSegmentPath(_path, number));
+    }
+
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED || memcmp(data, C8_TRACE_MAGIC.data(), C8_TRACE_MAGIC.size()) != 0)
+    {
+        if (data != MAP_FAILED)
+        {
+            munmap(data, file_stat.st_size);
+        }
+
+        close(fd);
+        throw std::runtime_error("Invalid trace segment: " + GetSegmentPath(_path, number));
+    }
+
+    _segment_number = number;
+    _fd = fd;
+    _data = static_cast<const uint8_t*>(data);
+    _size = file_stat.st_size;
+    _offset = C8_TRACE_MAGIC.size();
+
+    return true;
+}
+
+void Chip8TraceReader::CloseSegment()
+{
+    if (_fd >= 0)
+    {
+        munmap(const_cast<uint8_t*>(_data), _size);
+        close(_fd);
+    }
+
+    _fd = -1;
+    _data = nullptr;
+    _size = 0;
+    _offset = 0;
+}
+
+uint8_t Chip8TraceReader::ReadByte()
+{
+    if (_offset >= _size)
+    {
+        throw std::runtime_error("Truncated trace segment: " + GetSegmentPath(_path, _segment_number));
+    }
+
+    return _data[_offset++];
+}
+
+uint64_t Chip8TraceReader::ReadVarint()
+{
+    uint64_t value = 0;
+
+    for (auto shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte = ReadByte();
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+
+    throw std::runtime_error("Corrupted varint in trace segment: " + GetSegmentPath(_path, _segment_number));
+}
+
+bool Chip8TraceReader::Next(Chip8TraceStep& step)
+{
+    while (_offset >= _size || _data[_offset] == 0x00)
+    {
+        uint32_t next_segment_number = _segment_number + 1;
+
+        CloseSegment();
+        if (!OpenSegment(next_segment_number))
+        {
+            _segment_number = next_segment_number - 1;
+            return false;
+        }
+    }
+
+    auto read_u16 = [this]()
+    {
+        uint16_t low = ReadByte();
+        return static_cast<uint16_t>(low | (ReadByte() << 8));
+    };
+
+    auto read_signed_varint = [this]()
+    {
+        auto value = static_cast<uint32_t>(ReadVarint());
+        return static_cast<int32_t>((value >> 1) ^ -(value & 1));
+    };
+
+    uint8_t tag = ReadByte();
+
+    if (tag == TRACE_TAG_KEYFRAME)
+    {
+        _state.index = ReadVarint();
+        _state.pc = read_u16();
+        _state.opcode = read_u16();
+
+        for (auto& reg: _state.general)
+        {
+            reg = ReadByte();
+        }
+
+        _state.i = read_u16();
+        _state.delay = ReadByte();
+        _state.sound = ReadByte();
+        _state.write_length = ReadByte();
+        _state.write_address = _state.write_length != 0 ? read_u16() : 0;
+    }
+    else if ((tag & TRACE_TAG_DELTA) != 0)
+    {
+        _state.index++;
+        _state.opcode = read_u16();
+        _state.pc += 2;
+
+        if ((tag & TRACE_FLAG_PC_JUMP) != 0)
+        {
+            _state.pc += read_signed_varint();
+        }
+
+        if ((tag & TRACE_FLAG_REGISTERS) != 0)
+        {
+            uint16_t changed_registers = read_u16();
+
+            for (auto i = 0; i < 16; i++)
+            {
+                if ((changed_registers & (1 << i)) != 0)
+                {
+                    _state.general[i] = ReadByte();
+                }
+            }
+        }
+
+        if ((tag & TRACE_FLAG_INDEX) != 0)
+        {
+            _state.i += read_signed_varint();
+        }
+
+        if ((tag & TRACE_FLAG_TIMERS) != 0)
+        {
+            _state.delay = ReadByte();
+            _state.sound = ReadByte();
+        }
+
+        _state.write_length = 0;
+        _state.write_address = 0;
+
+        if ((tag & TRACE_FLAG_WRITE) != 0)
+        {
+            _state.write_address = read_u16();
+            _state.write_length = ReadByte();
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Corrupted record in trace segment: " + GetSegmentPath(_path, _segment_number));
+    }
+
+    if (_state.write_length > _state.written.size())
+    {
+        throw std::runtime_error("Corrupted record in trace segment: " + GetSegmentPath(_path, _segment_number));
+    }
+
+    for (auto i = 0; i < _state.write_length; i++)
+    {
+        _state.written[i] = ReadByte();
+    }
+
+    step = _state;
+
+    return true;
+}
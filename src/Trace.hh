@@ -0,0 +1,218 @@
+#ifndef CALICOC8_TRACE_HH
+#define CALICOC8_TRACE_HH
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#if defined(__SSE2__) && defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+constexpr size_t C8_TRACE_SEGMENT_SIZE = 16 * 1024 * 1024;
+
+// Upper bound of a single encoded record, writer rotates segments when less than that is left
+constexpr size_t C8_TRACE_MAX_RECORD_SIZE = 128;
+
+// State of the machine right after executing a single instruction
+struct Chip8TraceStep
+{
+    uint64_t index = 0;
+    uint16_t pc = 0x200;
+    uint16_t opcode = 0x0000;
+    std::array<uint8_t, 16> general{0};
+    uint16_t i = 0x00;
+    uint8_t delay = 0x00;
+    uint8_t sound = 0x00;
+
+    // Memory written by this instruction (Fx33, Fx55)
+    uint16_t write_address = 0x00;
+    uint8_t write_length = 0;
+    std::array<uint8_t, 16> written{0};
+};
+
+// Raw record the emulation thread appends for every instruction, state right after it. Registers other than Vx
+// and VF only change in the 5xxx and Fxxx groups, neither writes VF on its own so their records hold flags in
+// place of it, followed by the slots the flags ask for. I only changes in Axxx, taken from the opcode, and Fxxx.
+struct Chip8TraceRawRecord
+{
+    uint16_t pc = 0;
+    uint16_t opcode = 0;
+    uint8_t vx = 0;
+    uint8_t vf_or_flags = 0;
+    uint8_t delay = 0;
+    uint8_t sound = 0;
+};
+
+// Followed by a slot holding I
+constexpr uint8_t C8_TRACE_RAW_I = 1 << 0;
+// Followed by V0-V7 and V8-VF, whichever half a multi register load touched
+constexpr uint8_t C8_TRACE_RAW_LOW_REGISTERS = 1 << 1;
+constexpr uint8_t C8_TRACE_RAW_HIGH_REGISTERS = 1 << 2;
+// Fx33, Fx55 and XO-CHIP 5xy2 only store registers at I, the encoder rebuilds the written bytes
+constexpr uint8_t C8_TRACE_RAW_WRITE = 1 << 3;
+// Machine state was replaced from outside, the record only resynchronizes the encoder and isn't a step
+constexpr uint8_t C8_TRACE_RAW_STATE_ONLY = 1 << 4;
+
+constexpr size_t C8_TRACE_RAW_SLOT_SIZE = 8;
+static_assert(sizeof(Chip8TraceRawRecord) == C8_TRACE_RAW_SLOT_SIZE, "Raw records are whole slots");
+
+// Largest raw record, I and the whole register file
+constexpr size_t C8_TRACE_MAX_RAW_RECORD_SIZE = 4 * C8_TRACE_RAW_SLOT_SIZE;
+
+constexpr size_t C8_TRACE_RAW_CHUNK_SIZE = 4 * 1024 * 1024;
+constexpr uintptr_t C8_TRACE_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+// Raw records waiting for the encoder, faulted in when the trace starts so appending never takes a page fault.
+// The emulation thread blocks once it's this far ahead.
+constexpr size_t C8_TRACE_MAX_RAW_CHUNKS = 32;
+
+// Raw records are only read back by the encoder thread, non temporal stores skip loading their lines into cache
+inline void StoreRawSlot(uint8_t* slot, const void* source)
+{
+#if defined(__SSE2__) && defined(__x86_64__)
+    long long value;
+    std::memcpy(&value, source, sizeof(value));
+    _mm_stream_si64(reinterpret_cast<long long*>(slot), value);
+#else
+    std::memcpy(slot, source, C8_TRACE_RAW_SLOT_SIZE);
+#endif
+}
+
+inline bool HasTraceFlags(uint16_t opcode)
+{
+    return ((1u << 0x5 | 1u << 0xF) >> (opcode >> 12) & 1) != 0;
+}
+
+inline size_t GetRawRecordSize(uint8_t flags)
+{
+    int slots = 1 + (flags & C8_TRACE_RAW_I) + ((flags & C8_TRACE_RAW_LOW_REGISTERS) >> 1) +
+                ((flags & C8_TRACE_RAW_HIGH_REGISTERS) >> 2);
+
+    return slots * C8_TRACE_RAW_SLOT_SIZE;
+}
+
+// Each segment is a separate file named <path>.<segment number>, starting with a keyframe
+// holding absolute values, followed by records delta encoded against the previous one.
+// The emulation thread only appends raw records into memory chunks, a background thread encodes them
+// into the segments.
+class Chip8TraceWriter
+{
+public:
+    // Initial state is what the first records are applied to, its index is the one before the first record
+    explicit Chip8TraceWriter(const std::string& path, const Chip8TraceStep& initial,
+                              size_t segment_size = C8_TRACE_SEGMENT_SIZE);
+    ~Chip8TraceWriter();
+
+    Chip8TraceWriter(const Chip8TraceWriter&) = delete;
+    Chip8TraceWriter& operator=(const Chip8TraceWriter&) = delete;
+
+    // Space for one raw record of up to C8_TRACE_MAX_RAW_RECORD_SIZE bytes
+    uint8_t* Reserve(size_t size)
+    {
+        if (static_cast<size_t>(_raw_end - _raw_cursor) < size)
+        {
+            SwitchRawChunk();
+        }
+
+        uint8_t* record = _raw_cursor;
+        _raw_cursor += size;
+
+        return record;
+    }
+
+    // State replaced outside of instructions, later records apply to this one
+    void Resynchronize(const Chip8TraceStep& state);
+
+private:
+    struct Segment
+    {
+        uint32_t number = 0;
+        int fd = -1;
+        uint8_t* data = nullptr;
+        size_t used = 0;
+    };
+
+    struct RawChunk
+    {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+    };
+
+    // Emulation thread
+    void SwitchRawChunk();
+    static uint8_t* MapRawRegion();
+
+    // Encoder thread
+    void EncoderLoop();
+    void EncodeChunk(const RawChunk& chunk);
+    void RebuildWrittenBytes();
+    void EncodeStep();
+    void WriteKeyframe(const Chip8TraceStep& step);
+    void WriteDelta(const Chip8TraceStep& step);
+    void RotateSegment();
+
+    Segment MapSegment(uint32_t number);
+    void UnmapSegment(const Segment& segment);
+
+    std::string _path;
+    size_t _segment_size;
+
+    uint8_t* _raw_region = nullptr;
+    uint8_t* _raw_cursor = nullptr;
+    uint8_t* _raw_end = nullptr;
+    RawChunk _raw_chunk{};
+
+    Chip8TraceStep _step{};
+    Chip8TraceStep _last{};
+    Segment _current{};
+    uint8_t* _cursor = nullptr;
+    uint8_t* _rotate_threshold = nullptr;
+    bool _needs_keyframe = true;
+
+    // Shared between both threads
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<RawChunk> _filled_chunks;
+    std::vector<uint8_t*> _free_chunks;
+    std::string _encoder_error;
+    bool _stopping = false;
+    std::thread _encoder_thread;
+};
+
+class Chip8TraceReader
+{
+public:
+    explicit Chip8TraceReader(const std::string& path);
+    ~Chip8TraceReader();
+
+    Chip8TraceReader(const Chip8TraceReader&) = delete;
+    Chip8TraceReader& operator=(const Chip8TraceReader&) = delete;
+
+    // Returns false after last record of the last segment
+    bool Next(Chip8TraceStep& step);
+
+private:
+    bool OpenSegment(uint32_t number);
+    void CloseSegment();
+
+    uint8_t ReadByte();
+    uint64_t ReadVarint();
+
+    std::string _path;
+    uint32_t _segment_number = 0;
+
+    int _fd = -1;
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+    size_t _offset = 0;
+
+    Chip8TraceStep _state{};
+};
+
+#endif //CALICOC8_TRACE_HH
@@ -1,16 +1,56 @@
+#include <exception>
 #include <iostream>
 #include "CommandLine.hh"
 #include "Emulator.hh"
+#include "GridViewer.hh"
+#include "RomCatalog.hh"
 
 int main(int argc, char** argv)
 {
     if (argc < 2 || std::string(argv[1]) == "help")
     {
         std::cout << "usage: calico-c8 <rom-path or 'help'>" << std::endl;
+        std::cout << "       calico-c8 grid <rom-path>... [arguments]" << std::endl;
 
         return -1;
     }
 
+    if (std::string(argv[1]) == "grid")
+    {
+        // ROMs come first, arguments apply to every instance
+        std::vector<std::string> rom_paths;
+        int arg_index = 2;
+
+        for (; arg_index < argc && argv[arg_index][0] != '-'; arg_index++)
+        {
+            rom_paths.emplace_back(argv[arg_index]);
+        }
+
+        if (rom_paths.empty())
+        {
+            std::cout << "usage: calico-c8 grid <rom-path>... [arguments]" << std::endl;
+
+            return -1;
+        }
+
+        ApplicationCmdSettings grid_args{};
+
+        try
+        {
+            grid_args = ParseSpecialArguments(std::vector<std::string>(argv + arg_index, argv + argc));
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << e.what() << std::endl;
+
+            return -2;
+        }
+
+        GridViewer grid_viewer(grid_args);
+
+        return grid_viewer.Run(rom_paths);
+    }
+
     ApplicationCmdSettings parsed_args{};
     std::string rom_path = argv[1];
 
@@ -21,8 +61,25 @@ int main(int argc, char** argv)
         try
         {
             parsed_args = ParseSpecialArguments(special_args);
+
+            // Explicit arguments still win over the catalog
+            if (!parsed_args.catalog_path.empty())
+            {
+                Chip8RomCatalog catalog(parsed_args.catalog_path);
+                uint64_t hash = catalog.HashFile(rom_path);
+
+                if (auto metadata = catalog.FindMetadata(hash))
+                {
+                    ApplicationCmdSettings catalog_args{};
+                    catalog_args.variant = metadata->variant;
+                    catalog_args.clock_speed = metadata->clock_speed;
+                    catalog_args.keymap = metadata->keymap;
+
+                    parsed_args = ParseSpecialArguments(special_args, catalog_args);
+                }
+            }
         }
-        catch (const std::invalid_argument& e)
+        catch (const std::exception& e)
         {
             std::cout << e.what() << std::endl;
 
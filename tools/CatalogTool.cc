@@ -0,0 +1,122 @@
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "RomCatalog.hh"
+
+static std::string FormatMetadata(const std::optional<Chip8RomMetadata>& metadata)
+{
+    if (!metadata)
+    {
+        return "-";
+    }
+
+    return FormatChip8Variant(metadata->variant) + " " + std::to_string(metadata->clock_speed) + "hz " +
+           metadata->keymap;
+}
+
+static void PrintEntry(uint64_t hash, const std::optional<Chip8RomMetadata>& metadata, const std::string& path)
+{
+    std::cout << std::hex << std::setfill('0') << std::setw(16) << hash << std::dec << "  "
+              << FormatMetadata(metadata) << "  " << path << std::endl;
+}
+
+static Chip8RomMetadata ParseMetadataArguments(const std::vector<std::string>& args, Chip8RomMetadata metadata)
+{
+    for (auto& arg: args)
+    {
+        std::string value = arg.substr(arg.find(':') + 1);
+
+        if (arg.rfind("-variant:", 0) == 0)
+        {
+            metadata.variant = ParseChip8Variant(value);
+        }
+        else if (arg.rfind("-clock_speed:", 0) == 0)
+        {
+            metadata.clock_speed = std::stoul(value);
+        }
+        else if (arg.rfind("-keymap:", 0) == 0)
+        {
+            ValidateKeymap(value);
+            metadata.keymap = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    return metadata;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-catalog <dir> scan" << std::endl
+                  << "       calico-catalog <dir> list" << std::endl
+                  << "       calico-catalog <dir> lookup <rom>" << std::endl
+                  << "       calico-catalog <dir> set <rom> [-variant:x] [-clock_speed:x] [-keymap:x]" << std::endl;
+
+        return -1;
+    }
+
+    std::string command = argv[2];
+
+    try
+    {
+        Chip8RomCatalog catalog(argv[1]);
+
+        if (command == "scan" && argc == 3)
+        {
+            auto start = std::chrono::steady_clock::now();
+            size_t hashed_files = catalog.Scan();
+            catalog.Save();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << catalog.GetFiles().size() << " ROMs indexed, " << hashed_files << " hashed in "
+                      << seconds << " s" << std::endl;
+        }
+        else if (command == "list" && argc == 3)
+        {
+            for (auto& file: catalog.GetFiles())
+            {
+                PrintEntry(file.hash, catalog.FindMetadata(file.hash), file.path);
+            }
+        }
+        else if (command == "lookup" && argc == 4)
+        {
+            uint64_t hash = catalog.HashFile(argv[3]);
+
+            PrintEntry(hash, catalog.FindMetadata(hash), argv[3]);
+        }
+        else if (command == "set" && argc >= 4)
+        {
+            uint64_t hash = catalog.HashFile(argv[3]);
+            auto metadata = ParseMetadataArguments(std::vector<std::string>(argv + 4, argv + argc),
+                                                   catalog.FindMetadata(hash).value_or(Chip8RomMetadata{}));
+
+            catalog.SetMetadata(hash, metadata);
+            catalog.Save();
+
+            PrintEntry(hash, metadata, argv[3]);
+        }
+        else
+        {
+            std::cout << "Invalid command: " << command << ", type 'help'" << std::endl;
+
+            return -2;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Analyzer.hh"
+#include "RomFile.hh"
+
+// Analysis is repeated this many times when timing, a single run is too short to measure
+constexpr int CFG_TOOL_TIMING_RUNS = 1000;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-cfg <rom> [-format:dot|json] [-time]" << std::endl;
+
+        return -1;
+    }
+
+    std::string format = "dot";
+    bool print_time = false;
+
+    for (auto i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "-format:dot" || arg == "-format:json")
+        {
+            format = arg.substr(arg.find(':') + 1);
+        }
+        else if (arg == "-time")
+        {
+            print_time = true;
+        }
+        else
+        {
+            std::cout << "Invalid command line argument: " << arg << std::endl;
+
+            return -2;
+        }
+    }
+
+    try
+    {
+        auto binary = ReadBinaryToVector(argv[1]);
+        auto graph = AnalyzeROM(binary);
+
+        std::cout << (format == "json" ? FormatControlFlowGraphAsJson(graph) : FormatControlFlowGraphAsDot(graph));
+
+        if (print_time)
+        {
+            auto start = std::chrono::steady_clock::now();
+            size_t block_count = 0;
+
+            for (auto run = 0; run < CFG_TOOL_TIMING_RUNS; run++)
+            {
+                block_count += AnalyzeROM(binary).blocks.size();
+            }
+
+            auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+
+            std::cerr << "analysis: " << elapsed.count() / CFG_TOOL_TIMING_RUNS << " us ("
+                      << block_count / CFG_TOOL_TIMING_RUNS << " blocks)" << std::endl;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Differential.hh"
+#include "RomFile.hh"
+
+struct DiffToolSettings
+{
+    std::string candidate_engine_name;
+    std::vector<std::string> rom_paths;
+    Chip8DifferentialSettings differential{};
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct RomOutcome
+{
+    std::string error;
+    Chip8DifferentialResult result{};
+};
+
+static Chip8CompareGranularity ParseGranularity(const std::string& value)
+{
+    if (value == "instruction")
+    {
+        return Chip8CompareGranularity::Instruction;
+    }
+
+    if (value == "block")
+    {
+        return Chip8CompareGranularity::Block;
+    }
+
+    if (value == "frame")
+    {
+        return Chip8CompareGranularity::Frame;
+    }
+
+    throw std::invalid_argument(value);
+}
+
+// Directories are expanded to every regular file inside them, recursively
+static std::vector<std::string> CollectRomPaths(const std::vector<std::string>& paths)
+{
+    std::vector<std::string> rom_paths;
+
+    for (auto& path: paths)
+    {
+        if (!std::filesystem::is_directory(path))
+        {
+            rom_paths.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> directory_paths;
+        for (auto& entry: std::filesystem::recursive_directory_iterator(path))
+        {
+            if (entry.is_regular_file())
+            {
+                directory_paths.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(directory_paths.begin(), directory_paths.end());
+        rom_paths.insert(rom_paths.end(), directory_paths.begin(), directory_paths.end());
+    }
+
+    return rom_paths;
+}
+
+static DiffToolSettings ParseDiffToolArguments(const std::vector<std::string>& args)
+{
+    DiffToolSettings settings{};
+    std::vector<std::string> paths;
+
+    for (auto& arg: args)
+    {
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-variant:", 0) == 0)
+            {
+                settings.differential.variant = ParseChip8Variant(value);
+            }
+            else if (arg.rfind("-granularity:", 0) == 0)
+            {
+                settings.differential.granularity = ParseGranularity(value);
+            }
+            else if (arg.rfind("-instructions:", 0) == 0)
+            {
+                settings.differential.max_instructions = std::stoull(value);
+            }
+            else if (arg.rfind("-seed:", 0) == 0)
+            {
+                settings.differential.seed = std::stoul(value);
+            }
+            else if (arg.rfind("-threads:", 0) == 0)
+            {
+                settings.threads = std::max(1, std::stoi(value));
+            }
+            else if (arg[0] == '-')
+            {
+                throw std::invalid_argument(arg);
+            }
+            else if (settings.candidate_engine_name.empty())
+            {
+                settings.candidate_engine_name = arg;
+            }
+            else
+            {
+                paths.push_back(arg);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    // Fails early on unknown engine names, instead of once per ROM
+    CreateChip8Engine(settings.candidate_engine_name);
+
+    settings.rom_paths = CollectRomPaths(paths);
+    if (settings.rom_paths.empty())
+    {
+        throw std::invalid_argument("No ROMs given");
+    }
+
+    return settings;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-diff <candidate-engine> <rom-or-directory>... [-granularity:instruction|block|frame]"
+                  << " [-variant:x] [-instructions:x] [-seed:x] [-threads:x]" << std::endl
+                  << "engines:";
+
+        for (auto& name: GetChip8EngineNames())
+        {
+            std::cout << " " << name;
+        }
+
+        std::cout << std::endl;
+
+        return -1;
+    }
+
+    DiffToolSettings settings{};
+
+    try
+    {
+        settings = ParseDiffToolArguments(std::vector<std::string>(argv + 1, argv + argc));
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return -2;
+    }
+
+    std::vector<RomOutcome> outcomes(settings.rom_paths.size());
+    std::atomic<size_t> next_rom{0};
+    std::vector<std::thread> workers;
+
+    for (unsigned int i = 0; i < std::min<size_t>(settings.threads, settings.rom_paths.size()); i++)
+    {
+        workers.emplace_back([&]
+                             {
+                                 for (size_t index = next_rom++; index < settings.rom_paths.size(); index = next_rom++)
+                                 {
+                                     try
+                                     {
+                                         outcomes[index].result = RunDifferential(
+                                                 settings.candidate_engine_name,
+                                                 ReadBinaryToVector(settings.rom_paths[index]),
+                                                 settings.differential);
+                                     }
+                                     catch (const std::exception& e)
+                                     {
+                                         outcomes[index].error = e.what();
+                                     }
+                                 }
+                             });
+    }
+
+    for (auto& worker: workers)
+    {
+        worker.join();
+    }
+
+    int failed_roms = 0;
+
+    for (size_t index = 0; index < outcomes.size(); index++)
+    {
+        auto& outcome = outcomes[index];
+        auto& path = settings.rom_paths[index];
+
+        if (!outcome.error.empty())
+        {
+            failed_roms++;
+
+            std::cout << "ERROR    " << path << ": " << outcome.error << std::endl;
+        }
+        else if (outcome.result.diverged)
+        {
+            failed_roms++;
+
+            std::cout << "DIVERGED " << path << " at instruction " << outcome.result.instructions
+                      << " (frame " << outcome.result.frames << ", PC=0x" << std::hex << std::uppercase
+                      << outcome.result.pc << std::dec << ")" << std::endl;
+
+            for (auto& difference: outcome.result.differences)
+            {
+                std::cout << "    " << difference << std::endl;
+            }
+        }
+        else
+        {
+            std::cout << "MATCH    " << path << " (" << outcome.result.instructions << " instructions)" << std::endl;
+        }
+    }
+
+    return failed_roms == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Explorer.hh"
+#include "RomFile.hh"
+
+struct ExploreToolSettings
+{
+    std::string rom_path;
+    std::string output_path;
+    bool new_screens_only = false;
+
+    // Set by replay subcommand
+    bool replay = false;
+    std::string replay_inputs;
+
+    Chip8ExplorerSettings explorer{};
+};
+
+static std::string FormatHash(uint64_t hash)
+{
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(16) << hash;
+
+    return stream.str();
+}
+
+static ExploreToolSettings ParseExploreToolArguments(const std::vector<std::string>& args)
+{
+    ExploreToolSettings settings{};
+    settings.explorer.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> positional;
+
+    for (auto& arg: args)
+    {
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-depth:", 0) == 0)
+            {
+                settings.explorer.max_depth = std::stoul(value);
+            }
+            else if (arg.rfind("-states:", 0) == 0)
+            {
+                settings.explorer.max_states = std::max(1ul, std::stoul(value));
+            }
+            else if (arg.rfind("-frames:", 0) == 0)
+            {
+                settings.explorer.frames_per_input = std::max(1ul, std::stoul(value));
+            }
+            else if (arg.rfind("-clock:", 0) == 0)
+            {
+                settings.explorer.instructions_per_frame = std::max(1ul, std::stoul(value) / 60);
+            }
+            else if (arg.rfind("-threads:", 0) == 0)
+            {
+                settings.explorer.threads = std::max(1, std::stoi(value));
+            }
+            else if (arg.rfind("-seed:", 0) == 0)
+            {
+                settings.explorer.seed = std::stoul(value);
+            }
+            else if (arg.rfind("-output:", 0) == 0)
+            {
+                settings.output_path = value;
+            }
+            else if (arg == "-new-screens-only")
+            {
+                settings.new_screens_only = true;
+            }
+            else if (arg[0] == '-')
+            {
+                throw std::invalid_argument(arg);
+            }
+            else
+            {
+                positional.push_back(arg);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    if (!positional.empty() && positional[0] == "replay")
+    {
+        if (positional.size() < 2 || positional.size() > 3)
+        {
+            throw std::invalid_argument("replay needs a ROM and an input sequence");
+        }
+
+        settings.replay = true;
+        settings.rom_path = positional[1];
+        settings.replay_inputs = positional.size() == 3 ? positional[2] : "";
+    }
+    else if (positional.size() == 1)
+    {
+        settings.rom_path = positional[0];
+    }
+    else
+    {
+        throw std::invalid_argument("Expected a single ROM");
+    }
+
+    return settings;
+}
+
+static void PrintFrameBuffer(const Chip8FrameBuffer& frame_buffer)
+{
+    for (auto y = 0; y < frame_buffer.GetHeight(); y++)
+    {
+        std::string line;
+
+        for (auto x = 0; x < frame_buffer.GetWidth(); x++)
+        {
+            line += frame_buffer.GetPixelFrom2DCords(x, y) ? '#' : ' ';
+        }
+
+        std::cout << line << std::endl;
+    }
+}
+
+static int Replay(const ExploreToolSettings& settings, const std::vector<uint8_t>& rom)
+{
+    auto state = ReplayInputs(rom, settings.explorer, ParseExplorerInputs(settings.replay_inputs));
+
+    std::cout << "state=" << FormatHash(HashMachineState(state))
+              << " screen=" << FormatHash(HashFrameBuffer(state.frame_buffer)) << std::endl;
+    PrintFrameBuffer(state.frame_buffer);
+
+    return 0;
+}
+
+static int Explore(const ExploreToolSettings& settings, const std::vector<uint8_t>& rom)
+{
+    std::ofstream output_file;
+    if (!settings.output_path.empty())
+    {
+        output_file.open(settings.output_path);
+
+        if (!output_file)
+        {
+            throw std::runtime_error("Unable to open " + settings.output_path);
+        }
+    }
+
+    std::ostream& output = settings.output_path.empty() ? std::cout : output_file;
+
+    auto stats = ExploreROM(rom, settings.explorer, [&](const Chip8ExploredState& state)
+    {
+        if (settings.new_screens_only && !state.new_screen)
+        {
+            return;
+        }
+
+        output << "state=" << FormatHash(state.state_hash) << " screen=" << FormatHash(state.frame_buffer_hash)
+               << " new_screen=" << state.new_screen << " depth=" << state.inputs.size()
+               << " inputs=" << FormatExplorerInputs(state.inputs) << "\n";
+    });
+
+    output.flush();
+
+    std::cerr << "unique states:     " << stats.unique_states << std::endl
+              << "unique screens:    " << stats.unique_screens << std::endl
+              << "expanded states:   " << stats.expanded_states << std::endl
+              << "pruned duplicates: " << stats.pruned_states << std::endl
+              << "faulted branches:  " << stats.faulted_states << std::endl
+              << "max depth:         " << stats.max_depth_reached << std::endl
+              << "instructions:      " << stats.covered_instructions << " executed, "
+              << stats.reachable_instructions << " statically reachable" << std::endl
+              << "states per depth: ";
+
+    for (auto count: stats.states_per_depth)
+    {
+        std::cerr << " " << count;
+    }
+
+    std::cerr << std::endl << "time:              " << stats.seconds << " s ("
+              << static_cast<uint64_t>(stats.expanded_states * EXPLORER_INPUT_COUNT / std::max(stats.seconds, 1e-9))
+              << " steps/s)" << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-explore <rom> [-depth:x] [-states:x] [-frames:x] [-clock:x] [-threads:x] [-seed:x]"
+                  << " [-output:path] [-new-screens-only]" << std::endl
+                  << "       calico-explore replay <rom> <inputs> [-frames:x] [-clock:x] [-seed:x]" << std::endl;
+
+        return -1;
+    }
+
+    ExploreToolSettings settings{};
+
+    try
+    {
+        settings = ParseExploreToolArguments(std::vector<std::string>(argv + 1, argv + argc));
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return -2;
+    }
+
+    try
+    {
+        auto rom = ReadBinaryToVector(settings.rom_path);
+
+        return settings.replay ? Replay(settings, rom) : Explore(settings, rom);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return 1;
+    }
+}
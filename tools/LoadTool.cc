@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Interpreter.hh"
+#include "RomFile.hh"
+#include "ServerProtocol.hh"
+
+struct LoadToolSettings
+{
+    std::string socket_path;
+    std::string rom_path;
+    uint32_t sessions = 64;
+    uint32_t connections = 4;
+    uint32_t steps = 600;
+    uint32_t frames_per_step = 1;
+    // 0 steps as fast as the server answers
+    uint32_t fps = 0;
+    Chip8Variant variant = Chip8Variant::Chip8;
+    uint32_t clock_speed = 600;
+    // Cores available to the server, for the per core figures
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct LoadConnectionResult
+{
+    std::vector<double> step_latencies_us;
+    uint64_t delta_bytes = 0;
+    uint64_t mismatched_frames = 0;
+    uint64_t failed_steps = 0;
+    std::string error;
+};
+
+static LoadToolSettings ParseLoadToolArguments(const std::vector<std::string>& args)
+{
+    LoadToolSettings settings{};
+    std::vector<std::string> positional;
+
+    for (auto& arg: args)
+    {
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-sessions:", 0) == 0)
+            {
+                settings.sessions = std::max(1ul, std::stoul(value));
+            }
+            else if (arg.rfind("-connections:", 0) == 0)
+            {
+                settings.connections = std::max(1ul, std::stoul(value));
+            }
+            else if (arg.rfind("-steps:", 0) == 0)
+            {
+                settings.steps = std::max(1ul, std::stoul(value));
+            }
+            else if (arg.rfind("-frames:", 0) == 0)
+            {
+                settings.frames_per_step = std::clamp<unsigned long>(std::stoul(value), 1, C8_SERVER_MAX_STEP_FRAMES);
+            }
+            else if (arg.rfind("-fps:", 0) == 0)
+            {
+                settings.fps = std::stoul(value);
+            }
+            else if (arg.rfind("-variant:", 0) == 0)
+            {
+                settings.variant = ParseChip8Variant(value);
+            }
+            else if (arg.rfind("-clock_speed:", 0) == 0)
+            {
+                settings.clock_speed = std::max(1ul, std::stoul(value));
+            }
+            else if (arg.rfind("-cores:", 0) == 0)
+            {
+                settings.cores = std::max(1, std::stoi(value));
+            }
+            else if (arg[0] == '-')
+            {
+                throw std::invalid_argument(arg);
+            }
+            else
+            {
+                positional.push_back(arg);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    if (positional.size() != 2)
+    {
+        throw std::invalid_argument("Expected a socket path and a ROM");
+    }
+
+    settings.socket_path = positional[0];
+    settings.rom_path = positional[1];
+    settings.connections = std::min(settings.connections, settings.sessions);
+
+    return settings;
+}
+
+// Blocking client end of one server connection
+class LoadConnection
+{
+public:
+    explicit LoadConnection(const std::string& socket_path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        if (socket_path.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Server socket path too long: " + socket_path);
+        }
+
+        socket_path.copy(address.sun_path, socket_path.size());
+
+        _fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (_fd < 0 || connect(_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            if (_fd >= 0)
+            {
+                close(_fd);
+            }
+
+            throw std::runtime_error("Unable to connect to " + socket_path + ": " + strerror(errno));
+        }
+    }
+
+    ~LoadConnection()
+    {
+        close(_fd);
+    }
+
+    LoadConnection(const LoadConnection&) = delete;
+    LoadConnection& operator=(const LoadConnection&) = delete;
+
+    void Send(const std::vector<uint8_t>& bytes)
+    {
+        for (size_t sent = 0; sent < bytes.size();)
+        {
+            ssize_t result = send(_fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+
+            if (result < 0 && errno != EINTR)
+            {
+                throw std::runtime_error(std::string("Send failed: ") + strerror(errno));
+            }
+
+            sent += std::max<ssize_t>(result, 0);
+        }
+    }
+
+    // Payload stays valid until the next call
+    const uint8_t* Receive(Chip8ServerMessageHeader& header)
+    {
+        _input.erase(_input.begin(), _input.begin() + _consumed);
+        _consumed = 0;
+
+        while (!HasMessage())
+        {
+            size_t offset = _input.size();
+            _input.resize(offset + 64 * 1024);
+
+            ssize_t received = recv(_fd, _input.data() + offset, 64 * 1024, 0);
+            _input.resize(offset + std::max<ssize_t>(received, 0));
+
+            if (received == 0 || (received < 0 && errno != EINTR))
+            {
+                throw std::runtime_error("Server closed the connection");
+            }
+        }
+
+        std::memcpy(&header, _input.data(), sizeof(header));
+        _consumed = sizeof(header) + header.size;
+
+        return _input.data() + sizeof(header);
+    }
+
+private:
+    bool HasMessage() const
+    {
+        Chip8ServerMessageHeader header{};
+
+        if (_input.size() < sizeof(header))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, _input.data(), sizeof(header));
+
+        return _input.size() >= sizeof(header) + header.size;
+    }
+
+    int _fd = -1;
+    std::vector<uint8_t> _input;
+    size_t _consumed = 0;
+};
+
+static std::vector<uint8_t> EncodeRequest(Chip8ServerMessageType type, uint32_t session, uint32_t tag,
+                                          const void* payload = nullptr, size_t size = 0)
+{
+    std::vector<uint8_t> bytes;
+
+    Chip8ServerMessageHeader header{};
+    header.type = type;
+    header.session = session;
+    header.tag = tag;
+
+    AppendServerMessage(bytes, header, payload, size);
+
+    return bytes;
+}
+
+static void ExpectOk(const Chip8ServerMessageHeader& header, const uint8_t* payload, const char* request)
+{
+    if (header.status != Chip8ServerStatus::Ok)
+    {
+        throw std::runtime_error(std::string(request) + " failed with status " +
+                                 std::to_string(static_cast<int>(header.status)) + ": " +
+                                 std::string(reinterpret_cast<const char*>(payload), header.size));
+    }
+}
+
+// Runs session_count sessions over one connection, every round steps all of them with pipelined requests
+static void RunConnection(const LoadToolSettings& settings, const std::vector<uint8_t>& rom, uint32_t session_count,
+                          LoadConnectionResult& result)
+{
+    LoadConnection connection(settings.socket_path);
+    Chip8ServerMessageHeader header{};
+
+    Chip8ServerCreateRequest create{};
+    create.variant = static_cast<uint8_t>(settings.variant);
+    create.clock_speed = settings.clock_speed;
+
+    std::vector<uint8_t> requests;
+    for (auto i = 0u; i < session_count; i++)
+    {
+        create.seed = i + 1;
+        auto request = EncodeRequest(Chip8ServerMessageType::CreateSession, 0, i, &create, sizeof(create));
+        requests.insert(requests.end(), request.begin(), request.end());
+    }
+
+    connection.Send(requests);
+
+    std::vector<uint32_t> sessions(session_count);
+    for (auto i = 0u; i < session_count; i++)
+    {
+        ExpectOk(header, connection.Receive(header), "CreateSession");
+        sessions[header.tag] = header.session;
+    }
+
+    requests.clear();
+    for (auto session: sessions)
+    {
+        auto request = EncodeRequest(Chip8ServerMessageType::LoadRom, session, 0, rom.data(), rom.size());
+        requests.insert(requests.end(), request.begin(), request.end());
+    }
+
+    connection.Send(requests);
+
+    for (auto i = 0u; i < session_count; i++)
+    {
+        ExpectOk(header, connection.Receive(header), "LoadRom");
+    }
+
+    std::vector<Chip8ServerFrame> frames(session_count);
+    result.step_latencies_us.reserve(static_cast<size_t>(settings.steps) * session_count);
+
+    auto next_round = std::chrono::steady_clock::now();
+
+    for (auto round = 0u; round < settings.steps; round++)
+    {
+        if (settings.fps != 0)
+        {
+            std::this_thread::sleep_until(next_round);
+            next_round += std::chrono::nanoseconds(1000000000 / settings.fps);
+        }
+
+        requests.clear();
+
+        for (auto i = 0u; i < session_count; i++)
+        {
+            // Keys are held for a while so games actually react to them
+            if (round % 30 == 0)
+            {
+                Chip8ServerKeyRequest key{static_cast<uint8_t>((round / 60 + i) % 16),
+                                          static_cast<uint8_t>(round % 60 == 0)};
+                auto request = EncodeRequest(Chip8ServerMessageType::Key, sessions[i], i, &key, sizeof(key));
+                requests.insert(requests.end(), request.begin(), request.end());
+            }
+
+            Chip8ServerStepRequest step{settings.frames_per_step};
+            auto request = EncodeRequest(Chip8ServerMessageType::Step, sessions[i], i, &step, sizeof(step));
+            requests.insert(requests.end(), request.begin(), request.end());
+        }
+
+        auto sent = std::chrono::steady_clock::now();
+        connection.Send(requests);
+
+        for (auto answered = 0u; answered < session_count;)
+        {
+            const uint8_t* payload = connection.Receive(header);
+
+            if (header.type != Chip8ServerMessageType::Step)
+            {
+                ExpectOk(header, payload, "Key");
+                continue;
+            }
+
+            answered++;
+            result.step_latencies_us.push_back(
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+
+            if (header.status != Chip8ServerStatus::Ok)
+            {
+                result.failed_steps++;
+                continue;
+            }
+
+            ApplyFrameDelta(frames[header.tag], payload, header.size);
+            result.delta_bytes += header.size;
+        }
+    }
+
+    // Screens rebuilt from deltas have to match the server's
+    requests.clear();
+    for (auto i = 0u; i < session_count; i++)
+    {
+        auto request = EncodeRequest(Chip8ServerMessageType::FetchFrame, sessions[i], i);
+        requests.insert(requests.end(), request.begin(), request.end());
+    }
+
+    connection.Send(requests);
+
+    for (auto i = 0u; i < session_count; i++)
+    {
+        const uint8_t* payload = connection.Receive(header);
+        ExpectOk(header, payload, "FetchFrame");
+
+        Chip8ServerFrame fetched{};
+        ApplyFrameDelta(fetched, payload, header.size);
+
+        if (fetched.words != frames[header.tag].words || fetched.high_resolution != frames[header.tag].high_resolution)
+        {
+            result.mismatched_frames++;
+        }
+    }
+}
+
+static double Percentile(const std::vector<double>& sorted_values, double percentile)
+{
+    if (sorted_values.empty())
+    {
+        return 0;
+    }
+
+    auto index = static_cast<size_t>(percentile / 100.0 * (sorted_values.size() - 1) + 0.5);
+
+    return sorted_values[std::min(index, sorted_values.size() - 1)];
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-load <socket-path> <rom> [-sessions:x] [-connections:x] [-steps:x] [-frames:x]"
+                  << " [-fps:x] [-variant:x] [-clock_speed:x] [-cores:x]" << std::endl;
+
+        return -1;
+    }
+
+    try
+    {
+        auto settings = ParseLoadToolArguments(std::vector<std::string>(argv + 1, argv + argc));
+        auto rom = ReadBinaryToVector(settings.rom_path);
+
+        std::vector<LoadConnectionResult> results(settings.connections);
+        std::vector<std::thread> threads;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (auto i = 0u; i < settings.connections; i++)
+        {
+            // Sessions spread as evenly as possible
+            uint32_t session_count = settings.sessions / settings.connections +
+                                     (i < settings.sessions % settings.connections ? 1 : 0);
+
+            threads.emplace_back([&settings, &rom, &results, i, session_count]
+                                 {
+                                     try
+                                     {
+                                         RunConnection(settings, rom, session_count, results[i]);
+                                     }
+                                     catch (const std::exception& e)
+                                     {
+                                         results[i].error = e.what();
+                                     }
+                                 });
+        }
+
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> latencies;
+        LoadConnectionResult total{};
+
+        for (auto& result: results)
+        {
+            if (!result.error.empty())
+            {
+                throw std::runtime_error(result.error);
+            }
+
+            latencies.insert(latencies.end(), result.step_latencies_us.begin(), result.step_latencies_us.end());
+            total.delta_bytes += result.delta_bytes;
+            total.mismatched_frames += result.mismatched_frames;
+            total.failed_steps += result.failed_steps;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+
+        double frames_per_second = static_cast<double>(latencies.size()) * settings.frames_per_step / seconds;
+        // Sessions that could run at full speed, 60 frames per second each
+        double realtime_sessions = frames_per_second / 60.0;
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "{\"sessions\":" << settings.sessions
+                  << ",\"connections\":" << settings.connections
+                  << ",\"steps\":" << latencies.size()
+                  << ",\"frames_per_step\":" << settings.frames_per_step
+                  << ",\"seconds\":" << seconds
+                  << ",\"frames_per_second\":" << frames_per_second
+                  << ",\"realtime_sessions\":" << realtime_sessions
+                  << ",\"realtime_sessions_per_core\":" << realtime_sessions / settings.cores
+                  << ",\"p50_step_us\":" << Percentile(latencies, 50)
+                  << ",\"p99_step_us\":" << Percentile(latencies, 99)
+                  << ",\"max_step_us\":" << Percentile(latencies, 100)
+                  << ",\"delta_bytes_per_step\":" << static_cast<double>(total.delta_bytes) /
+                                                     std::max<size_t>(latencies.size(), 1)
+                  << ",\"failed_steps\":" << total.failed_steps
+                  << ",\"mismatched_frames\":" << total.mismatched_frames << "}" << std::endl;
+
+        return total.mismatched_frames == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return 1;
+    }
+}
@@ -0,0 +1,90 @@
+#include <csignal>
+#include <exception>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Server.hh"
+
+static Chip8Server* running_server = nullptr;
+
+static void HandleStopSignal(int)
+{
+    running_server->Stop();
+}
+
+static Chip8ServerSettings ParseServerToolArguments(const std::vector<std::string>& args)
+{
+    Chip8ServerSettings settings{};
+
+    for (auto& arg: args)
+    {
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-workers:", 0) == 0)
+            {
+                settings.workers = std::max(1, std::stoi(value));
+            }
+            else if (arg.rfind("-sessions:", 0) == 0)
+            {
+                settings.max_sessions = std::stoul(value);
+            }
+            else if (arg[0] == '-' || !settings.socket_path.empty())
+            {
+                throw std::invalid_argument(arg);
+            }
+            else
+            {
+                settings.socket_path = arg;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    if (settings.socket_path.empty())
+    {
+        throw std::invalid_argument("Expected a socket path");
+    }
+
+    return settings;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-server <socket-path> [-workers:x] [-sessions:x]" << std::endl;
+
+        return -1;
+    }
+
+    try
+    {
+        auto settings = ParseServerToolArguments(std::vector<std::string>(argv + 1, argv + argc));
+        Chip8Server server(settings);
+
+        running_server = &server;
+        std::signal(SIGINT, HandleStopSignal);
+        std::signal(SIGTERM, HandleStopSignal);
+
+        std::cout << "Listening on " << settings.socket_path << " with " << settings.workers << " workers"
+                  << std::endl;
+        server.Run();
+
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "SharedFrames.hh"
+
+// Example consumer, prints the screen of a running 'calico-c8 <rom> -shm:name' instance as text
+int main(int argc, char** argv)
+{
+    if (argc < 2 || std::string(argv[1]) == "help")
+    {
+        std::cout << "usage: calico-shm-reader <name> [-frames:x]" << std::endl;
+
+        return -1;
+    }
+
+    uint64_t frame_limit = 0;
+
+    if (argc > 2)
+    {
+        std::string arg = argv[2];
+
+        try
+        {
+            if (arg.rfind("-frames:", 0) != 0)
+            {
+                throw std::invalid_argument(arg);
+            }
+
+            frame_limit = std::stoull(arg.substr(arg.find(':') + 1));
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Invalid command line argument: " << arg << std::endl;
+
+            return -2;
+        }
+    }
+
+    try
+    {
+        Chip8SharedFrameReader reader(argv[1]);
+
+        uint64_t last_published = 0;
+        uint64_t shown_frames = 0;
+        uint64_t torn_reads = 0;
+
+        while (frame_limit == 0 || shown_frames < frame_limit)
+        {
+            uint64_t published = reader.GetPublishedFrameCount();
+
+            if (published == last_published)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            // Formatting works on the shared slot directly, the text is only printed once the read is known to be
+            // consistent
+            std::string screen;
+
+            bool consistent = reader.ReadLatest([&screen](const Chip8SharedFrameSlot& slot)
+                                                {
+                                                    screen = "frame " + std::to_string(slot.frame) +
+                                                             " PC=" + std::to_string(slot.pc) +
+                                                             " I=" + std::to_string(slot.i) +
+                                                             " DT=" + std::to_string(slot.delay) +
+                                                             " ST=" + std::to_string(slot.sound) + "\n";
+
+                                                    for (auto y = 0; y < slot.height; y++)
+                                                    {
+                                                        for (auto x = 0; x < slot.width; x++)
+                                                        {
+                                                            screen += slot.pixels[(y * slot.width + x) * 4] != 0
+                                                                      ? '#' : ' ';
+                                                        }
+
+                                                        screen += '\n';
+                                                    }
+                                                });
+
+            if (!consistent)
+            {
+                torn_reads++;
+                continue;
+            }
+
+            last_published = published;
+            shown_frames++;
+
+            // Cursor back to the top left corner, redraws in place
+            std::cout << "\033[H" << screen << "torn reads: " << torn_reads << std::endl;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return 1;
+    }
+
+    return 0;
+}
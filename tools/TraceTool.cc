@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Trace.hh"
+
+struct TraceFilter
+{
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    int pc = -1;
+
+    // Hex digits of the opcode, any other character matches every nibble (ex. 'Fx55', 'D???')
+    std::string opcode_pattern;
+};
+
+static std::string FormatHex(unsigned int value, int width)
+{
+    std::stringstream stream;
+    stream << std::uppercase << std::hex << std::setfill('0') << std::setw(width) << value;
+
+    return stream.str();
+}
+
+static bool MatchesOpcodePattern(uint16_t opcode, const std::string& pattern)
+{
+    if (pattern.empty())
+    {
+        return true;
+    }
+
+    std::string opcode_hex = FormatHex(opcode, 4);
+
+    for (auto i = 0; i < 4; i++)
+    {
+        if (isxdigit(pattern[i]) && toupper(pattern[i]) != opcode_hex[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool MatchesFilter(const Chip8TraceStep& step, const TraceFilter& filter)
+{
+    return step.index >= filter.from && step.index <= filter.to &&
+           (filter.pc < 0 || step.pc == filter.pc) &&
+           MatchesOpcodePattern(step.opcode, filter.opcode_pattern);
+}
+
+// Prints only what changed relative to the previous step, like the trace itself stores it
+static std::string FormatStep(const Chip8TraceStep& step, const Chip8TraceStep& previous)
+{
+    std::string line = "#" + std::to_string(step.index) + " PC=" + FormatHex(step.pc, 3) +
+                       " " + FormatHex(step.opcode, 4);
+
+    for (auto i = 0; i < 16; i++)
+    {
+        if (step.general[i] != previous.general[i])
+        {
+            line += " V" + FormatHex(i, 1) + "=" + FormatHex(step.general[i], 2);
+        }
+    }
+
+    if (step.i != previous.i)
+    {
+        line += " I=" + FormatHex(step.i, 3);
+    }
+
+    if (step.delay != previous.delay)
+    {
+        line += " DT=" + FormatHex(step.delay, 2);
+    }
+
+    if (step.sound != previous.sound)
+    {
+        line += " ST=" + FormatHex(step.sound, 2);
+    }
+
+    if (step.write_length != 0)
+    {
+        line += " [" + FormatHex(step.write_address, 3) + "]=";
+
+        for (auto i = 0; i < step.write_length; i++)
+        {
+            line += FormatHex(step.written[i], 2);
+        }
+    }
+
+    return line;
+}
+
+static std::string FindStepDifference(const Chip8TraceStep& a, const Chip8TraceStep& b)
+{
+    if (a.pc != b.pc)
+    {
+        return "PC";
+    }
+
+    if (a.opcode != b.opcode)
+    {
+        return "opcode";
+    }
+
+    for (auto i = 0; i < 16; i++)
+    {
+        if (a.general[i] != b.general[i])
+        {
+            return "V" + FormatHex(i, 1);
+        }
+    }
+
+    if (a.i != b.i)
+    {
+        return "I";
+    }
+
+    if (a.delay != b.delay || a.sound != b.sound)
+    {
+        return "timers";
+    }
+
+    if (a.write_length != b.write_length || a.write_address != b.write_address ||
+        !std::equal(a.written.begin(), a.written.begin() + a.write_length, b.written.begin()))
+    {
+        return "memory write";
+    }
+
+    return "";
+}
+
+static int DumpTrace(const std::string& path, const TraceFilter& filter)
+{
+    Chip8TraceReader reader(path);
+    Chip8TraceStep previous{};
+    Chip8TraceStep step{};
+
+    while (reader.Next(step) && step.index <= filter.to)
+    {
+        if (MatchesFilter(step, filter))
+        {
+            std::cout << FormatStep(step, previous) << '\n';
+        }
+
+        previous = step;
+    }
+
+    std::cout.flush();
+
+    return 0;
+}
+
+static int DiffTraces(const std::string& path_a, const std::string& path_b)
+{
+    Chip8TraceReader reader_a(path_a);
+    Chip8TraceReader reader_b(path_b);
+    Chip8TraceStep previous{};
+    Chip8TraceStep step_a{};
+    Chip8TraceStep step_b{};
+
+    while (true)
+    {
+        bool has_a = reader_a.Next(step_a);
+        bool has_b = reader_b.Next(step_b);
+
+        if (!has_a && !has_b)
+        {
+            std::cout << "Traces are identical" << std::endl;
+
+            return 0;
+        }
+
+        if (has_a != has_b)
+        {
+            std::cout << "Trace " << (has_a ? path_b : path_a) << " ends after "
+                      << (has_a ? step_a.index : step_b.index) - 1 << " instructions" << std::endl;
+
+            return 1;
+        }
+
+        std::string difference = FindStepDifference(step_a, step_b);
+        if (!difference.empty())
+        {
+            std::cout << "First divergence in " << difference << " at instruction " << step_a.index << std::endl
+                      << "< " << FormatStep(step_a, previous) << std::endl
+                      << "> " << FormatStep(step_b, previous) << std::endl;
+
+            return 1;
+        }
+
+        previous = step_a;
+    }
+}
+
+static TraceFilter ParseFilterArguments(const std::vector<std::string>& args)
+{
+    TraceFilter filter{};
+
+    for (auto& arg: args)
+    {
+        auto value = arg.substr(arg.find(':') + 1);
+
+        try
+        {
+            if (arg.rfind("-from:", 0) == 0)
+            {
+                filter.from = std::stoull(value);
+            }
+            else if (arg.rfind("-to:", 0) == 0)
+            {
+                filter.to = std::stoull(value);
+            }
+            else if (arg.rfind("-pc:", 0) == 0)
+            {
+                filter.pc = std::stoi(value, nullptr, 16);
+            }
+            else if (arg.rfind("-opcode:", 0) == 0 && value.size() == 4)
+            {
+                filter.opcode_pattern = value;
+            }
+            else
+            {
+                throw std::invalid_argument(arg);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            throw std::invalid_argument("Invalid command line argument: " + arg);
+        }
+    }
+
+    return filter;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    try
+    {
+        if (args.size() >= 2 && args[0] == "dump")
+        {
+            return DumpTrace(args[1], ParseFilterArguments({args.begin() + 2, args.end()}));
+        }
+
+        if (args.size() == 3 && args[0] == "diff")
+        {
+            return DiffTraces(args[1], args[2]);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        return -2;
+    }
+
+    std::cout << "usage: calico-trace dump <trace-path> [-from:x] [-to:x] [-pc:hex] [-opcode:pattern]" << std::endl
+              << "       calico-trace diff <trace-path> <trace-path>" << std::endl;
+
+    return -1;
+}